@@ -0,0 +1,115 @@
+#include "Benchmark.h"
+#include <cmath>
+#include <stdexcept>
+using namespace std;
+using namespace Eigen;
+
+// Definitions and domains follow the "Virtual Library of Simulation
+// Experiments" by Surjanovic and Bingham
+double branin(const VectorXd& x)
+{
+    const double a = 1;
+    const double b = 5.1 / (4 * M_PI * M_PI);
+    const double c = 5 / M_PI;
+    const double r = 6;
+    const double s = 10;
+    const double t = 1 / (8 * M_PI);
+    return a * pow(x(1) - b * x(0) * x(0) + c * x(0) - r, 2) + s * (1 - t) * cos(x(0)) + s;
+}
+double ackley(const VectorXd& x)
+{
+    const double a = 20;
+    const double b = 0.2;
+    const double c = 2 * M_PI;
+    const double d = x.size();
+    return -a * exp(-b * sqrt(x.squaredNorm() / d)) - exp((c * x.array()).cos().sum() / d) + a + exp(1);
+}
+double rosenbrock(const VectorXd& x)
+{
+    const long d = x.size();
+    double val   = 0;
+    for(long i = 0; i + 1 < d; ++i)
+        val += 100 * pow(x(i + 1) - x(i) * x(i), 2) + pow(x(i) - 1, 2);
+    return val;
+}
+double hartmann6(const VectorXd& x)
+{
+    static const double alpha[4] = {1.0, 1.2, 3.0, 3.2};
+    static const double A[4][6]  = {
+        {10,   3,   17,   3.5, 1.7, 8},
+        {0.05, 10,  17,   0.1, 8,   14},
+        {3,    3.5, 1.7,  10,  17,  8},
+        {17,   8,   0.05, 10,  0.1, 14}};
+    static const double P[4][6] = {
+        {0.1312, 0.1696, 0.5569, 0.0124, 0.8283, 0.5886},
+        {0.2329, 0.4135, 0.8307, 0.3736, 0.1004, 0.9991},
+        {0.2348, 0.1451, 0.3522, 0.2883, 0.3047, 0.6650},
+        {0.4047, 0.8828, 0.8732, 0.5743, 0.1091, 0.0381}};
+    double val = 0;
+    for(size_t i = 0; i < 4; ++i)
+    {
+        double inner = 0;
+        for(size_t j = 0; j < 6; ++j)
+            inner += A[i][j] * pow(x(j) - P[i][j], 2);
+        val -= alpha[i] * exp(-inner);
+    }
+    return val;
+}
+double alpine1(const VectorXd& x)
+{
+    return (x.array() * x.array().sin() + 0.1 * x.array()).abs().sum();
+}
+vector<string> bench_func_names()
+{
+    return {"branin", "ackley", "rosenbrock", "hartmann6", "alpine1"};
+}
+BenchFunc bench_func(string name, size_t dim)
+{
+    typedef double (*Func)(const VectorXd&);
+    Func f;
+    BenchFunc bf;
+    bf.name = name;
+    if(name == "branin")
+    {
+        bf.lb  = (VectorXd(2) << -5, 0).finished();
+        bf.ub  = (VectorXd(2) << 10, 15).finished();
+        bf.opt = 0.397887357729738;
+        f      = branin;
+    }
+    else if(name == "ackley")
+    {
+        bf.lb  = VectorXd::Constant(dim, -32.768);
+        bf.ub  = VectorXd::Constant(dim, 32.768);
+        bf.opt = 0;
+        f      = ackley;
+    }
+    else if(name == "rosenbrock")
+    {
+        bf.lb  = VectorXd::Constant(dim, -5);
+        bf.ub  = VectorXd::Constant(dim, 10);
+        bf.opt = 0;
+        f      = rosenbrock;
+    }
+    else if(name == "hartmann6")
+    {
+        bf.lb  = VectorXd::Zero(6);
+        bf.ub  = VectorXd::Ones(6);
+        bf.opt = -3.32236801141551;
+        f      = hartmann6;
+    }
+    else if(name == "alpine1")
+    {
+        bf.lb  = VectorXd::Constant(dim, -10);
+        bf.ub  = VectorXd::Constant(dim, 10);
+        bf.opt = 0;
+        f      = alpine1;
+    }
+    else
+        throw invalid_argument("Unknown benchmark function: " + name);
+    if(bf.lb.size() < 2)
+        throw invalid_argument("Dimension of " + name + " should be at least 2");
+    bf.f = [f](const VectorXd& x) -> VectorXd {
+        return VectorXd::Constant(1, f(x));
+    };
+    return bf;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "MACE.h"
+#include <Eigen/Dense>
+#include <string>
+#include <vector>
+// In-process test functions for benchmarking the optimizer itself, without
+// the cost and noise of an external simulator
+struct BenchFunc
+{
+    std::string     name;
+    Eigen::VectorXd lb;
+    Eigen::VectorXd ub;
+    double          opt; // global minimum
+    MACE::Obj       f;
+};
+
+// Branin and Hartmann6 have fixed dimensions (2 and 6), `dim` is ignored for
+// them, an invalid_argument is thrown for unknown names
+BenchFunc bench_func(std::string name, size_t dim);
+std::vector<std::string> bench_func_names();
+
+double branin(const Eigen::VectorXd& x);
+double ackley(const Eigen::VectorXd& x);
+double rosenbrock(const Eigen::VectorXd& x);
+double hartmann6(const Eigen::VectorXd& x);
+double alpine1(const Eigen::VectorXd& x);
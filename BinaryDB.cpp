@@ -0,0 +1,90 @@
+#include "BinaryDB.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+using namespace Eigen;
+namespace
+{
+const char   magic[8]    = {'M', 'A', 'C', 'E', 'D', 'B', '1', '\n'};
+const size_t header_size = sizeof(magic) + 3 * sizeof(uint64_t);
+}
+BinaryDB::BinaryDB(string path) : _path(path)
+{
+    const int fd = open(_path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw runtime_error("Fail to open " + _path);
+    struct stat st;
+    if(fstat(fd, &st) != 0 or static_cast<size_t>(st.st_size) < header_size)
+    {
+        close(fd);
+        throw runtime_error(_path + " is not a MACE database");
+    }
+    _map_size = st.st_size;
+    _map      = mmap(nullptr, _map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(_map == MAP_FAILED)
+    {
+        _map = nullptr;
+        throw runtime_error("Fail to mmap " + _path);
+    }
+    madvise(_map, _map_size, MADV_SEQUENTIAL);
+
+    const char* bytes = static_cast<const char*>(_map);
+    uint64_t header[3];
+    memcpy(header, bytes + sizeof(magic), sizeof(header));
+    _dim      = header[0];
+    _num_spec = header[1];
+    _size     = header[2];
+    // the header is checked before the record size is computed, so that a
+    // corrupt header can neither overflow it nor divide by zero, and the
+    // records should fill the rest of the file exactly
+    const size_t max_values = numeric_limits<size_t>::max() / sizeof(double);
+    const size_t data_size  = _map_size - header_size;
+    bool valid = memcmp(bytes, magic, sizeof(magic)) == 0 and _dim > 0 and _num_spec > 0 and _dim <= max_values and
+                 _num_spec <= max_values - _dim;
+    if(valid)
+    {
+        const size_t record_size = (_dim + _num_spec) * sizeof(double);
+        valid = data_size % record_size == 0 and data_size / record_size == _size;
+    }
+    if(not valid)
+    {
+        munmap(_map, _map_size);
+        _map = nullptr;
+        throw runtime_error(_path + " is not a MACE database or its size does not match its header");
+    }
+    _records = reinterpret_cast<const double*>(bytes + header_size);
+}
+BinaryDB::~BinaryDB()
+{
+    if(_map != nullptr)
+        munmap(_map, _map_size);
+}
+void BinaryDB::write(string path, const MatrixXd& dbx, const MatrixXd& dby)
+{
+    if(dbx.cols() != dby.cols())
+        throw runtime_error("Size of dbx and dby mismatch");
+    ofstream f(path, ios::binary);
+    if(not f.is_open())
+        throw runtime_error("Fail to create " + path);
+    const uint64_t header[3] = {static_cast<uint64_t>(dbx.rows()), static_cast<uint64_t>(dby.rows()),
+                                static_cast<uint64_t>(dbx.cols())};
+    f.write(magic, sizeof(magic));
+    f.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for(long i = 0; i < dbx.cols(); ++i)
+    {
+        const VectorXd x = dbx.col(i);
+        const VectorXd y = dby.col(i);
+        f.write(reinterpret_cast<const char*>(x.data()), sizeof(double) * x.size());
+        f.write(reinterpret_cast<const char*>(y.data()), sizeof(double) * y.size());
+    }
+    if(not f.good())
+        throw runtime_error("Fail to write " + path);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <Eigen/Dense>
+#include <string>
+// Memory-mapped binary database of evaluated points, used to warm-start MACE
+//
+// Layout, all values are little-endian:
+//     8 bytes   magic "MACEDB1\n"
+//     uint64    dim
+//     uint64    num_spec
+//     uint64    number of records
+//     records   each record is `dim` doubles of x followed by `num_spec`
+//               doubles of y
+class BinaryDB
+{
+public:
+    explicit BinaryDB(std::string path);
+    ~BinaryDB();
+    BinaryDB(const BinaryDB&) = delete;
+    BinaryDB& operator=(const BinaryDB&) = delete;
+
+    size_t dim() const { return _dim; }
+    size_t num_spec() const { return _num_spec; }
+    size_t size() const { return _size; }
+    const double* x(size_t i) const { return _records + i * (_dim + _num_spec); }
+    const double* y(size_t i) const { return x(i) + _dim; }
+
+    static void write(std::string path, const Eigen::MatrixXd& dbx, const Eigen::MatrixXd& dby);
+
+private:
+    std::string   _path;
+    void*         _map      = nullptr;
+    size_t        _map_size = 0;
+    size_t        _dim      = 0;
+    size_t        _num_spec = 0;
+    size_t        _size     = 0;
+    const double* _records  = nullptr;
+};
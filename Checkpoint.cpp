@@ -0,0 +1,96 @@
+#include "Checkpoint.h"
+#include <cstdint>
+#include <stdexcept>
+#include <unistd.h>
+using namespace std;
+using namespace Eigen;
+CheckpointWriter::CheckpointWriter(string path) : _path(path), _tmp_path(path + ".tmp")
+{
+    _f = fopen(_tmp_path.c_str(), "wb");
+    if(_f == nullptr)
+        throw runtime_error("Fail to create checkpoint file " + _tmp_path);
+}
+CheckpointWriter::~CheckpointWriter()
+{
+    if(_f != nullptr)
+    {
+        // not committed, the previous checkpoint is kept
+        fclose(_f);
+        remove(_tmp_path.c_str());
+    }
+}
+void CheckpointWriter::_write(const void* data, size_t size)
+{
+    if(fwrite(data, 1, size, _f) != size)
+        throw runtime_error("Fail to write checkpoint file " + _tmp_path);
+}
+void CheckpointWriter::write(size_t v)
+{
+    const uint64_t u = v;
+    _write(&u, sizeof(u));
+}
+void CheckpointWriter::write(double v) { _write(&v, sizeof(v)); }
+void CheckpointWriter::write(const string& s)
+{
+    write(s.size());
+    _write(s.data(), s.size());
+}
+void CheckpointWriter::write(const MatrixXd& m)
+{
+    write(static_cast<size_t>(m.rows()));
+    write(static_cast<size_t>(m.cols()));
+    _write(m.data(), sizeof(double) * m.size());
+}
+void CheckpointWriter::commit()
+{
+    if(fflush(_f) != 0 or fsync(fileno(_f)) != 0)
+        throw runtime_error("Fail to flush checkpoint file " + _tmp_path);
+    fclose(_f);
+    _f = nullptr;
+    if(rename(_tmp_path.c_str(), _path.c_str()) != 0)
+        throw runtime_error("Fail to rename " + _tmp_path + " to " + _path);
+}
+
+CheckpointReader::CheckpointReader(string path) : _path(path)
+{
+    _f = fopen(_path.c_str(), "rb");
+    if(_f == nullptr)
+        throw runtime_error("Fail to open checkpoint file " + _path);
+}
+CheckpointReader::~CheckpointReader()
+{
+    fclose(_f);
+}
+void CheckpointReader::_read(void* data, size_t size)
+{
+    if(fread(data, 1, size, _f) != size)
+        throw runtime_error("Truncated checkpoint file " + _path);
+}
+size_t CheckpointReader::read_size()
+{
+    uint64_t u;
+    _read(&u, sizeof(u));
+    return u;
+}
+double CheckpointReader::read_double()
+{
+    double v;
+    _read(&v, sizeof(v));
+    return v;
+}
+string CheckpointReader::read_string()
+{
+    const size_t size = read_size();
+    string s(size, '\0');
+    if(size > 0)
+        _read(&s[0], size);
+    return s;
+}
+MatrixXd CheckpointReader::read_matrix()
+{
+    const size_t rows = read_size();
+    const size_t cols = read_size();
+    MatrixXd m(rows, cols);
+    _read(m.data(), sizeof(double) * m.size());
+    return m;
+}
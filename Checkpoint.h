@@ -0,0 +1,39 @@
+#pragma once
+#include <Eigen/Dense>
+#include <cstdio>
+#include <string>
+// Binary checkpoint files, the file is written to `path.tmp` and renamed to
+// `path` by `commit`, so that a killed run never leaves a partially written
+// checkpoint
+class CheckpointWriter
+{
+public:
+    explicit CheckpointWriter(std::string path);
+    ~CheckpointWriter();
+    void write(size_t);
+    void write(double);
+    void write(const std::string&);
+    void write(const Eigen::MatrixXd&);
+    void commit();
+
+private:
+    std::string _path;
+    std::string _tmp_path;
+    FILE*       _f = nullptr;
+    void _write(const void* data, size_t size);
+};
+class CheckpointReader
+{
+public:
+    explicit CheckpointReader(std::string path);
+    ~CheckpointReader();
+    size_t          read_size();
+    double          read_double();
+    std::string     read_string();
+    Eigen::MatrixXd read_matrix();
+
+private:
+    std::string _path;
+    FILE*       _f = nullptr;
+    void _read(void* data, size_t size);
+};
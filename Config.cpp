@@ -1,9 +1,15 @@
 #include "Config.h"
 #include "util.h"
 #include "MACE_util.h"
+#include "Worker.h"
+#include "Plugin.h"
+#include "Process.h"
+#include <cstdio>
 #include <fstream>
+#include <limits>
 #include <iomanip>
 #include <sstream>
+#include <memory>
 #include <omp.h>
 using namespace std;
 using namespace Eigen;
@@ -47,6 +53,15 @@ void Config::parse()
         {
             ss >> _algo;
         }
+        else if (tok == "init_db")
+        {
+            ss >> _init_db;
+        }
+        else if (tok == "plugin")
+        {
+            ss >> _plugin;
+            getline(ss >> ws, _plugin_arg);
+        }
     }
     MYASSERT(_des_var_names.size() == lbs.size());
     MYASSERT(_des_var_names.size() == ubs.size());
@@ -54,17 +69,62 @@ void Config::parse()
     _des_var_ub = convert(ubs);
     f.close();
 }
+void Config::set_resume(bool flag) { _resume = flag; }
 string Config::work_dir() const { return _work_dir; }
 const map<string, double>& Config::options() const { return _options; }
 VectorXd Config::lb() const { return _des_var_lb; }
 VectorXd Config::ub() const { return _des_var_ub; }
-MACE::Obj Config::gen_obj()
+size_t Config::_prepare_work_dirs() const
 {
+    // a new run fails on the `work` directory of an earlier one, so that
+    // stale simulator outputs are never read, the work directories left by
+    // the killed run are only reused when resuming
     string cir_dir = _work_dir + "/circuit";
-    run_cmd("mkdir "  + _work_dir + "/work/");
+    run_cmd((_resume ? "mkdir -p " : "mkdir ") + _work_dir + "/work/");
     const size_t num_threads = omp_get_max_threads();
     for(size_t i = 0; i < num_threads; ++i)
-        run_cmd("cp -r " + cir_dir + " " + _work_dir + "/work/" + to_string(i)); 
+    {
+        const string opt_dir = _work_dir + "/work/" + to_string(i);
+        run_cmd((_resume ? "[ -d " + opt_dir + " ] || " : string()) + "cp -r " + cir_dir + " " + opt_dir);
+    }
+    return num_threads;
+}
+MatrixXd Config::_run_script(const string& opt_dir, const string& script, long rows, long cols) const
+{
+    // The script is killed with all its children after `eval_timeout`
+    // seconds, a failed, killed or invalid run is retried `eval_retry` times,
+    // a cancelled one is not
+    const double timeout = with_default<double>(_options, "eval_timeout", 0);
+    const size_t retry   = with_default<size_t>(_options, "eval_retry", 0);
+    const string cmd     = "cd " + opt_dir + " && perl " + script + " > output_info.log 2>&1";
+    const string result_file = opt_dir + "/result.po";
+    for (size_t i = 0; i <= retry; ++i)
+    {
+        remove(result_file.c_str()); // a result left by the last run is not read
+        const ProcStatus status = run_process(cmd, timeout);
+        if (status == ProcStatus::Cancelled)
+            return MatrixXd();
+        if (status == ProcStatus::Success and ifstream(result_file).good())
+        {
+            MatrixXd result = read_matrix(result_file);
+            if (result.rows() == rows and result.cols() == cols)
+                return result;
+            cerr << result_file << " should have " << rows << " lines of " << cols << " values" << endl;
+        }
+        else if (status == ProcStatus::Timeout)
+            cerr << "Timeout after " << timeout << " sec: " << cmd << endl;
+        else
+            cerr << "Fail to run cmd " << cmd << endl;
+    }
+    return MatrixXd();
+}
+MACE::Obj Config::gen_obj()
+{
+    if(not _plugin.empty())
+        return _gen_plugin_obj(omp_get_max_threads());
+    const size_t num_threads = _prepare_work_dirs();
+    if(with_default<bool>(_options, "persistent_worker", false))
+        return _gen_worker_obj(num_threads);
     MACE::Obj f =  [&](const VectorXd& xs) -> VectorXd {
         // check range
         const size_t dim       = _des_var_names.size();
@@ -81,26 +141,138 @@ MACE::Obj Config::gen_obj()
         for (size_t j = 0; j < dim; ++j) 
             param_f << ".param " << _des_var_names[j] << " = " << xs(j) << endl;
         param_f.close();
-        const string cmd = "cd " + opt_dir + " && perl run.pl > output_info.log 2>&1";
-        int ret = system(cmd.c_str());
-        if (ret != 0)
-        {
-            cerr << "Fail to run cmd " << cmd << endl;
-            exit(EXIT_FAILURE);
-        }
-        MatrixXd result = read_matrix(opt_dir + "/result.po");
-        MYASSERT(result.rows() == 1);
-        MYASSERT((size_t)result.size() == num_spec);
+        const MatrixXd result = _run_script(opt_dir, "run.pl", 1, num_spec);
+        if (result.size() == 0)
+            return VectorXd::Constant(num_spec, numeric_limits<double>::quiet_NaN()); // penalized by MACE
         sim_results = result.transpose();
 
         return sim_results;
     };
     return f;
 }
+MACE::Obj Config::_gen_worker_obj(size_t num_threads)
+{
+    // One long-lived `worker.pl` for each `work/<i>` directory, started when
+    // the thread firstly evaluates, so that neither a shell nor a perl
+    // interpreter is created for each evaluation. A failed or killed
+    // evaluation is retried `eval_retry` times as for `run.pl`, by a new
+    // worker, a cancelled one is not
+    typedef vector<shared_ptr<Worker>> Pool;
+    shared_ptr<Pool> workers = make_shared<Pool>(num_threads);
+    MACE::Obj f = [&, workers](const VectorXd& xs) -> VectorXd {
+        const size_t dim      = _des_var_names.size();
+        const size_t num_spec = with_default<size_t>(_options, "num_spec", 1);
+        const double timeout  = with_default<double>(_options, "eval_timeout", 0);
+        const size_t retry    = with_default<size_t>(_options, "eval_retry", 0);
+        const size_t tid      = omp_get_thread_num();
+        MYASSERT((size_t)xs.rows() == dim);
+        MYASSERT(tid < workers->size());
+        shared_ptr<Worker>& worker = (*workers)[tid];
+        if(worker == nullptr)
+            worker = make_shared<Worker>(_work_dir + "/work/" + to_string(tid), "worker.pl", _des_var_names);
+        VectorXd y;
+        for(size_t i = 0; i <= retry; ++i)
+        {
+            const ProcStatus status = worker->eval(xs, num_spec, timeout, y);
+            if(status == ProcStatus::Success)
+                return y;
+            if(status == ProcStatus::Cancelled)
+                break;
+        }
+        return VectorXd::Constant(num_spec, numeric_limits<double>::quiet_NaN()); // penalized by MACE
+    };
+    return f;
+}
+shared_ptr<Plugin> Config::_load_plugin(size_t num_threads) const
+{
+    // The objective is evaluated in-process by the plugin, no work directory
+    // is created
+    try
+    {
+        const size_t num_spec = with_default<size_t>(_options, "num_spec", 1);
+        return make_shared<Plugin>(_plugin, _plugin_arg, _des_var_names.size(), num_spec, num_threads);
+    }
+    catch(const exception& e)
+    {
+        cerr << e.what() << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+MACE::Obj Config::_gen_plugin_obj(size_t num_threads)
+{
+    shared_ptr<Plugin> plugin = _load_plugin(num_threads);
+    MACE::Obj f = [plugin](const VectorXd& xs) -> VectorXd {
+        try
+        {
+            return plugin->eval(omp_get_thread_num(), xs);
+        }
+        catch(const exception& e)
+        {
+            cerr << e.what() << endl;
+            return VectorXd::Constant(plugin->num_spec(), numeric_limits<double>::quiet_NaN());
+        }
+    };
+    return f;
+}
+MACE::BatchObj Config::gen_batch_obj()
+{
+    // The whole batch is evaluated by one call: the plugin gets all the
+    // points at once, or `run_batch.pl` reads a `param` file with the names
+    // of the design variables in the first line and one point in each
+    // following line, and writes one line of `num_spec` values for each
+    // point to `result.po`. The batch objective is called by one thread in
+    // synchronous mode, and by each evaluation thread with one point in
+    // asynchronous mode, so each thread still has its own work directory and
+    // plugin handle
+    if(not _plugin.empty())
+    {
+        shared_ptr<Plugin> plugin = _load_plugin(omp_get_max_threads());
+        return [plugin](const MatrixXd& xs) -> MatrixXd {
+            try
+            {
+                return plugin->eval(omp_get_thread_num(), xs);
+            }
+            catch(const exception& e)
+            {
+                cerr << e.what() << endl;
+                return MatrixXd::Constant(plugin->num_spec(), xs.cols(), numeric_limits<double>::quiet_NaN());
+            }
+        };
+    }
+    _prepare_work_dirs();
+    return [&](const MatrixXd& xs) -> MatrixXd {
+        const size_t dim      = _des_var_names.size();
+        const size_t num_spec = with_default<size_t>(_options, "num_spec", 1);
+        const string opt_dir  = _work_dir + "/work/" + to_string(omp_get_thread_num());
+        MYASSERT((size_t)xs.rows() == dim);
+
+        ofstream param_f;
+        string param_file = opt_dir + "/param";
+        param_f.exceptions(param_f.badbit | param_f.failbit);
+        param_f << setprecision(18);
+        param_f.open(param_file);
+        for (size_t j = 0; j < dim; ++j)
+            param_f << (j == 0 ? "" : " ") << _des_var_names[j];
+        param_f << endl;
+        for (long i = 0; i < xs.cols(); ++i)
+        {
+            for (size_t j = 0; j < dim; ++j)
+                param_f << (j == 0 ? "" : " ") << xs(j, i);
+            param_f << endl;
+        }
+        param_f.close();
+        const MatrixXd result = _run_script(opt_dir, "run_batch.pl", xs.cols(), num_spec);
+        if (result.size() == 0)
+            return MatrixXd::Constant(num_spec, xs.cols(), numeric_limits<double>::quiet_NaN()); // penalized by MACE
+        return result.transpose();
+    };
+}
 void Config::print()
 {
     cout << "Conf path: " << _file_path << endl;
     cout << "work dir: " <<  _work_dir  << endl;
+    if(not _plugin.empty())
+        cout << "plugin: " << _plugin << " " << _plugin_arg << endl;
     for(size_t i = 0; i < _des_var_names.size(); ++i)
     {
         cout << _des_var_names[i] << ": " << _des_var_lb[i] << ", " << _des_var_ub[i] << endl;
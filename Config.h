@@ -1,6 +1,8 @@
 #pragma once
 #include "MACE.h"
+#include "Plugin.h"
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <Eigen/Dense>
@@ -15,16 +17,30 @@ class Config
     std::vector<std::string> _des_var_names;
     std::map<std::string, double> _options;
     std::string              _algo;
+    std::string              _init_db;
+    std::string              _plugin;
+    std::string              _plugin_arg;
+    bool                     _resume = false;
+    size_t _prepare_work_dirs() const; // one work directory for each thread, returns the number of threads
+    std::shared_ptr<Plugin> _load_plugin(size_t num_threads) const;
+    // run `script` in `opt_dir` and read its `rows` * `cols` result.po, empty on failure
+    Eigen::MatrixXd _run_script(const std::string& opt_dir, const std::string& script, long rows, long cols) const;
+    MACE::Obj _gen_worker_obj(size_t num_threads);
+    MACE::Obj _gen_plugin_obj(size_t num_threads);
 public:
     explicit Config(std::string);
     void parse();
     void print();
+    void set_resume(bool); // reuse the work directories of a killed run instead of failing on them
     std::string work_dir() const;
     const decltype(_options)& options() const;
     MACE::Obj gen_obj();
     MACE::Obj gen_obj(size_t num_threads);
+    MACE::BatchObj gen_batch_obj(); // one plugin call or one `run_batch.pl` run for each batch
     Eigen::VectorXd lb() const;
     Eigen::VectorXd ub() const;
     boost::optional<double> lookup(std::string) const;
     std::string algo() const { return _algo; }
+    std::string init_db() const { return _init_db; }
+    bool use_plugin() const { return not _plugin.empty(); }
 };
@@ -0,0 +1,92 @@
+#include "KDTree.h"
+#include <algorithm>
+using namespace std;
+using namespace Eigen;
+
+KDTree::KDTree(size_t dim)
+    : _dim(dim)
+{}
+void KDTree::build(const MatrixXd& pts)
+{
+    _points.clear();
+    _nodes.clear();
+    _points.reserve(pts.size());
+    _nodes.reserve(pts.cols());
+    vector<size_t> idxs(pts.cols());
+    for(size_t i = 0; i < idxs.size(); ++i)
+        idxs[i] = i;
+    _root = _build(idxs, 0, idxs.size(), 0, pts);
+}
+long KDTree::_build(vector<size_t>& idxs, size_t begin, size_t end, size_t depth, const MatrixXd& pts)
+{
+    // median split along the dimensions in turn
+    if(begin >= end)
+        return -1;
+    const size_t split = depth % _dim;
+    const size_t mid   = begin + (end - begin) / 2;
+    nth_element(idxs.begin() + begin, idxs.begin() + mid, idxs.begin() + end, [&](size_t i1, size_t i2)->bool{
+        return pts(split, i1) < pts(split, i2);
+    });
+    const long node   = _new_node(pts.col(idxs[mid]).data(), split);
+    const long left   = _build(idxs, begin, mid, depth + 1, pts);
+    const long right  = _build(idxs, mid + 1, end, depth + 1, pts);
+    _nodes[node].left  = left;
+    _nodes[node].right = right;
+    return node;
+}
+long KDTree::_new_node(const double* x, size_t split)
+{
+    _points.insert(_points.end(), x, x + _dim);
+    _nodes.push_back(Node{split, -1, -1});
+    return _nodes.size() - 1;
+}
+void KDTree::insert(const VectorXd& x)
+{
+    if(_root < 0)
+    {
+        _root = _new_node(x.data(), 0);
+        return;
+    }
+    long node = _root;
+    while(true)
+    {
+        const size_t split   = _nodes[node].split;
+        const bool   to_left = x(split) < _points[node * _dim + split];
+        const long   child   = to_left ? _nodes[node].left : _nodes[node].right;
+        if(child >= 0)
+        {
+            node = child;
+            continue;
+        }
+        const long new_node = _new_node(x.data(), (split + 1) % _dim);
+        if(to_left)
+            _nodes[node].left = new_node;
+        else
+            _nodes[node].right = new_node;
+        return;
+    }
+}
+bool KDTree::has_neighbor(const VectorXd& x, double radius) const
+{
+    const double r2 = radius * radius;
+    vector<long> stack;
+    if(_root >= 0)
+        stack.push_back(_root);
+    while(not stack.empty())
+    {
+        const long node = stack.back();
+        stack.pop_back();
+        const Map<const VectorXd> p(&_points[node * _dim], _dim);
+        if((x - p).squaredNorm() < r2)
+            return true;
+        const size_t split = _nodes[node].split;
+        const double diff  = x(split) - p(split);
+        const long   near  = diff < 0 ? _nodes[node].left : _nodes[node].right;
+        const long   far   = diff < 0 ? _nodes[node].right : _nodes[node].left;
+        if(far >= 0 and diff * diff < r2)
+            stack.push_back(far);
+        if(near >= 0)
+            stack.push_back(near);
+    }
+    return false;
+}
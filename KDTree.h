@@ -0,0 +1,33 @@
+#pragma once
+#include <Eigen/Dense>
+#include <vector>
+// k-d tree of points, used to reject duplicated evaluations
+//
+// The tree is built balanced from the initial data, points evaluated later are
+// inserted at the leaves without rebalancing. The coordinates are copied once
+// into the tree, queries never copy the indexed points
+class KDTree
+{
+public:
+    explicit KDTree(size_t dim);
+
+    void   build(const Eigen::MatrixXd& pts); // replace the indexed points, one column for each point
+    void   insert(const Eigen::VectorXd& x);
+    bool   has_neighbor(const Eigen::VectorXd& x, double radius) const; // is any point closer than radius to x
+    size_t size() const { return _nodes.size(); }
+
+private:
+    struct Node
+    {
+        size_t split;      // dimension to split
+        long   left;
+        long   right;
+    };
+    const size_t        _dim;
+    std::vector<double> _points; // coordinates of node i start from _points[i * _dim]
+    std::vector<Node>   _nodes;
+    long                _root = -1;
+
+    long _build(std::vector<size_t>& idxs, size_t begin, size_t end, size_t depth, const Eigen::MatrixXd& pts);
+    long _new_node(const double* x, size_t split);
+};
@@ -0,0 +1,153 @@
+#include "Logging.h"
+#include <boost/log/core.hpp>
+#include <boost/log/attributes/constant.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/bounded_fifo_queue.hpp>
+#include <boost/log/sinks/drop_on_overflow.hpp>
+#include <boost/log/sinks/text_file_backend.hpp>
+#include <boost/make_shared.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <set>
+#include <stdexcept>
+using namespace std;
+namespace logging = boost::log;
+namespace sinks   = boost::log::sinks;
+namespace expr    = boost::log::expressions;
+namespace attrs   = boost::log::attributes;
+
+typedef sinks::synchronous_sink<sinks::text_file_backend> SyncSink;
+typedef sinks::asynchronous_sink<sinks::text_file_backend, sinks::bounded_fifo_queue<4096, sinks::drop_on_overflow>> AsyncSink;
+
+// the asynchronous sinks alive, flushed by `flush_at_exit`, as `exit` is
+// called on errors without destroying MACE
+static mutex           live_mtx;
+static set<LogSink*>   live_sinks;
+static void flush_at_exit()
+{
+    lock_guard<mutex> lock(live_mtx);
+    for(LogSink* s : live_sinks)
+        s->flush();
+}
+
+LogSink::LogSink(string file_name, bool async, bool append, string study)
+    : _async(async), _study(study)
+{
+    auto backend = boost::make_shared<sinks::text_file_backend>();
+    backend->set_file_name_pattern(file_name);
+    backend->set_open_mode(append ? ios::out | ios::app : ios::out | ios::trunc);
+    backend->auto_flush(not async);
+    if(async)
+    {
+        static once_flag registered;
+        call_once(registered, []() { atexit(flush_at_exit); });
+        _sink = boost::make_shared<AsyncSink>(backend);
+        lock_guard<mutex> lock(live_mtx);
+        live_sinks.insert(this);
+    }
+    else
+        _sink = boost::make_shared<SyncSink>(backend);
+    set_level(logging::trivial::trace);
+    logging::core::get()->add_sink(_sink);
+}
+LogSink::~LogSink()
+{
+    logging::core::get()->remove_sink(_sink);
+    if(_async)
+    {
+        {
+            lock_guard<mutex> lock(live_mtx);
+            live_sinks.erase(this);
+        }
+        boost::static_pointer_cast<AsyncSink>(_sink)->stop();
+    }
+    flush();
+}
+void LogSink::set_level(logging::trivial::severity_level level)
+{
+    if(_study.empty())
+        _sink->set_filter(logging::trivial::severity >= level and not expr::has_attr<string>("Study"));
+    else
+        _sink->set_filter(logging::trivial::severity >= level and expr::attr<string>("Study") == _study);
+}
+StudyTag::StudyTag(string study)
+{
+    auto res = logging::core::get()->add_thread_attribute("Study", attrs::constant<string>(study));
+    _attr    = res.first;
+    _added   = res.second;
+}
+StudyTag::~StudyTag()
+{
+    if(_added)
+        logging::core::get()->remove_thread_attribute(_attr);
+}
+void LogSink::flush()
+{
+    if(_async)
+        boost::static_pointer_cast<AsyncSink>(_sink)->flush();
+    else
+        boost::static_pointer_cast<SyncSink>(_sink)->flush();
+}
+
+TraceWriter::TraceWriter(string path, size_t max_queued)
+    : _f(fopen(path.c_str(), "wb")), _max_queued(max_queued)
+{
+    if(_f == nullptr)
+        throw runtime_error("Fail to create trace file " + path);
+    fwrite("MACETRC1", 1, 8, _f);
+    _writer = thread(&TraceWriter::_write_loop, this);
+}
+TraceWriter::~TraceWriter()
+{
+    {
+        lock_guard<mutex> lock(_mtx);
+        _stopping = true;
+    }
+    _cv.notify_one();
+    _writer.join();
+    fclose(_f);
+}
+void TraceWriter::write(const string& tag, size_t num_eval, const Eigen::MatrixXd& data)
+{
+    {
+        lock_guard<mutex> lock(_mtx);
+        if(_queue.size() >= _max_queued)
+        {
+            ++_dropped;
+            return;
+        }
+        _queue.push_back(Record{tag, num_eval, data});
+    }
+    _cv.notify_one();
+}
+size_t TraceWriter::num_dropped() const
+{
+    lock_guard<mutex> lock(_mtx);
+    return _dropped;
+}
+void TraceWriter::_write_loop()
+{
+    auto write_size = [&](size_t v) {
+        const uint64_t u = v;
+        fwrite(&u, sizeof(u), 1, _f);
+    };
+    unique_lock<mutex> lock(_mtx);
+    while(true)
+    {
+        _cv.wait(lock, [&]() { return _stopping or not _queue.empty(); });
+        if(_queue.empty())
+            break;
+        Record r = move(_queue.front());
+        _queue.pop_front();
+        lock.unlock();
+        write_size(r.tag.size());
+        fwrite(r.tag.data(), 1, r.tag.size(), _f);
+        write_size(r.num_eval);
+        write_size(r.data.rows());
+        write_size(r.data.cols());
+        fwrite(r.data.data(), sizeof(double), r.data.size(), _f);
+        lock.lock();
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <Eigen/Dense>
+#include <boost/log/trivial.hpp>
+#include <boost/log/attributes/attribute_set.hpp>
+#include <boost/shared_ptr.hpp>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+namespace boost { namespace log { namespace sinks { class basic_sink_frontend; } } }
+
+// File sink of the Boost log for one MACE object.
+//
+// A synchronous sink writes and flushes each record in the logging thread, an
+// asynchronous sink only queues the record, a background thread writes it to
+// the file, when the bounded queue is full the record is dropped instead of
+// blocking. Queued records are written when the sink is destroyed or the
+// program calls `exit`.
+//
+// When several MACE objects share the process, the sink of a study only
+// writes the records tagged with its name by `StudyTag`, sinks without a
+// study only write the untagged records
+class LogSink
+{
+public:
+    LogSink(std::string file_name, bool async, bool append = false, std::string study = "");
+    ~LogSink();
+    LogSink(const LogSink&) = delete;
+    LogSink& operator=(const LogSink&) = delete;
+
+    void set_level(boost::log::trivial::severity_level level); // records below `level` are ignored
+    void flush();
+
+private:
+    boost::shared_ptr<boost::log::sinks::basic_sink_frontend> _sink;
+    bool _async;
+    std::string _study;
+};
+
+// Records logged by the current thread are tagged with `study` during the
+// lifetime of the tag
+class StudyTag
+{
+public:
+    explicit StudyTag(std::string study);
+    ~StudyTag();
+    StudyTag(const StudyTag&) = delete;
+    StudyTag& operator=(const StudyTag&) = delete;
+
+private:
+    boost::log::attribute_set::iterator _attr;
+    bool _added;
+};
+
+// Binary trace of the bulk numeric data (evaluated points, predictions), the
+// records are queued and written by a background thread, when more than
+// `max_queued` records are queued, the new records are dropped.
+//
+// Layout, all values are little-endian:
+//     8 bytes   magic "MACETRC1"
+//     records   uint64 length of tag, the tag, uint64 number of evaluations
+//               when recorded, uint64 rows, uint64 cols, rows * cols doubles
+//               in column-major order
+class TraceWriter
+{
+public:
+    explicit TraceWriter(std::string path, size_t max_queued = 1024);
+    ~TraceWriter();
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    void   write(const std::string& tag, size_t num_eval, const Eigen::MatrixXd& data);
+    size_t num_dropped() const;
+
+private:
+    struct Record
+    {
+        std::string     tag;
+        size_t          num_eval;
+        Eigen::MatrixXd data;
+    };
+    FILE*                   _f;
+    const size_t            _max_queued;
+    std::deque<Record>      _queue;
+    mutable std::mutex      _mtx;
+    std::condition_variable _cv;
+    bool                    _stopping = false;
+    size_t                  _dropped  = 0;
+    std::thread             _writer;
+    void _write_loop();
+};
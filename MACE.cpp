@@ -3,23 +3,44 @@
 #include "util.h"
 #include "MVMO.h"
 #include "NLopt_wrapper.h"
+#include "RefitFantasyGP.h"
+#include "Checkpoint.h"
+#include "BinaryDB.h"
+#include "TaskPool.h"
+#include "MACE_util.h"
+#include "Process.h"
 #include <boost/log/core.hpp>
 #include <boost/log/trivial.hpp>
-#include <boost/log/expressions.hpp>
-#include <boost/log/sinks/text_file_backend.hpp>
-#include <boost/log/utility/setup/file.hpp>
 #include <boost/log/utility/setup/common_attributes.hpp>
 #include <boost/log/sources/severity_logger.hpp>
 #include <boost/log/sources/record_ostream.hpp>
 #include <gsl/gsl_qrng.h>
 #include <omp.h>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <set>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <stdexcept>
 using namespace std;
 using namespace std::chrono;
 using namespace Eigen;
+
+// instead of `MYASSERT`, so that a failed check also stops only the MACE
+// object when `set_throw_on_error` is set
+#define MACE_CHECK(cond)                                  \
+    do                                                    \
+    {                                                     \
+        if(not (cond))                                    \
+            _fatal(string("Check failed: ") + #cond);     \
+    } while(0)
+
 MACE::MACE(Obj f, size_t num_spec, const VectorXd& lb, const VectorXd& ub, string log_name)
     : _func(f),
       _lb(lb),
@@ -42,31 +63,170 @@ MACE::MACE(Obj f, size_t num_spec, const VectorXd& lb, const VectorXd& ub, strin
       _eval_x(MatrixXd(_dim, 0)), 
       _eval_y(MatrixXd(_num_spec, 0))
 {
-    assert(_scaled_lb   < _scaled_ub);
-    assert((_lb.array() < _ub.array()).all());
-    if(_num_spec > 1)
-    {
-        cerr << "Num spec > 1, currently I only handle unconstrained problems" << endl;
-        exit(EXIT_FAILURE);
-    }
+    MACE_CHECK(_scaled_lb   < _scaled_ub);
+    MACE_CHECK((_lb.array() < _ub.array()).all());
     _init_boost_log();
     BOOST_LOG_TRIVIAL(info) << "MACE Created";
 }
+MACE::MACE(size_t num_spec, const VectorXd& lb, const VectorXd& ub, string log_name)
+    : MACE(Obj(), num_spec, lb, ub, log_name)
+{}
 MatrixXd MACE::_run_func(const MatrixXd& xs)
 {
-    bool no_improve = true;
+    Profiler::Scope scope(_prof, Profiler::Eval);
     const auto t1            = chrono::high_resolution_clock::now();
     const size_t num_pnts = xs.cols();
     const MatrixXd scaled_xs = _rescale(xs);
     MatrixXd ys(_num_spec, num_pnts);
-    BOOST_LOG_TRIVIAL(info) << "X:\n"        << _rescale(xs).transpose();
+    _log_data("X", scaled_xs.transpose());
+    if(_batch_func)
+    {
+        ys = _batch_func(scaled_xs);
+        if((size_t)ys.rows() != _num_spec or (size_t)ys.cols() != num_pnts)
+        {
+            _fatal("The batch objective returns " + to_string(ys.rows()) + "x" + to_string(ys.cols()) + " results for " + to_string(num_pnts) + " points");
+        }
+    }
+    else if(_speculate > 0 and num_pnts > 1 and omp_get_max_threads() > 1)
+        ys = _run_speculative(scaled_xs);
+    else
+    {
 #pragma omp parallel for
-    for(size_t i = 0; i < num_pnts; ++i)
+        for(size_t i = 0; i < num_pnts; ++i)
+        {
+            ys.col(i) = _func(scaled_xs.col(i));
+        }
+    }
+    _penalize_failures(ys);
+    _update_best(scaled_xs, ys);
+    const auto t2       = chrono::high_resolution_clock::now();
+    const double t_eval = static_cast<double>(chrono::duration_cast<milliseconds>(t2 -t1).count()) / 1000.0;
+    BOOST_LOG_TRIVIAL(info) << "Time for " << num_pnts << " evaluations: " << t_eval << " sec";
+    return ys;
+}
+VectorXd MACE::_run_one(const VectorXd& scaled_x)
+{
+    if(not _batch_func)
+        return _func(scaled_x);
+    const MatrixXd ys = _batch_func(scaled_x);
+    if((size_t)ys.rows() != _num_spec or ys.cols() != 1)
     {
-        ys.col(i) = _func(scaled_xs.col(i));
+        _fatal("The batch objective returns " + to_string(ys.rows()) + "x" + to_string(ys.cols()) + " results for 1 point");
     }
-
+    return ys.col(0);
+}
+MatrixXd MACE::_run_speculative(const MatrixXd& scaled_xs)
+{
+    // Each thread evaluates the points not started yet, when there is none
+    // and half of the batch has finished, an idle thread duplicates a
+    // straggler, a point running longer than `_speculate` times the median
+    // time of the finished points. The first successful copy is used, the
+    // other copies are cancelled through `EvalCancelScope`
+    typedef chrono::steady_clock Clock;
+    const size_t num_pnts = scaled_xs.cols();
+    MatrixXd ys(_num_spec, num_pnts);
+    vector<size_t> num_running(num_pnts, 0);
+    vector<bool> finished(num_pnts, false);
+    vector<Clock::time_point> started(num_pnts);
+    vector<double> durations;
+    unique_ptr<atomic<bool>[]> cancel(new atomic<bool>[num_pnts]);
     for(size_t i = 0; i < num_pnts; ++i)
+        cancel[i] = false;
+    size_t next         = 0;
+    size_t num_finished = 0;
+    mutex mtx;
+#pragma omp parallel
+    {
+        while(true)
+        {
+            long idx = -1;
+            {
+                lock_guard<mutex> lock(mtx);
+                if(num_finished == num_pnts)
+                    break;
+                if(next < num_pnts)
+                {
+                    idx          = next++;
+                    started[idx] = Clock::now();
+                }
+                else if(2 * durations.size() >= num_pnts)
+                {
+                    vector<double> sorted = durations;
+                    nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+                    const double median = sorted[sorted.size() / 2];
+                    for(size_t i = 0; i < num_pnts; ++i)
+                    {
+                        const double elapsed = chrono::duration<double>(Clock::now() - started[i]).count();
+                        if(not finished[i] and num_running[i] == 1 and elapsed > _speculate * median)
+                        {
+                            idx = i;
+                            BOOST_LOG_TRIVIAL(info) << "Duplicate the evaluation of point " << i << ", running for " << elapsed << " sec";
+                            break;
+                        }
+                    }
+                }
+                if(idx >= 0)
+                    ++num_running[idx];
+            }
+            if(idx < 0)
+            {
+                this_thread::sleep_for(chrono::milliseconds(50));
+                continue;
+            }
+            VectorXd y;
+            {
+                EvalCancelScope scope(&cancel[idx]);
+                y = _func(scaled_xs.col(idx));
+            }
+            lock_guard<mutex> lock(mtx);
+            --num_running[idx];
+            // a failed copy waits for the other copies
+            if(not finished[idx] and (y.allFinite() or num_running[idx] == 0))
+            {
+                finished[idx] = true;
+                cancel[idx]   = true;
+                ys.col(idx)   = y;
+                durations.push_back(chrono::duration<double>(Clock::now() - started[idx]).count());
+                ++num_finished;
+            }
+        }
+    }
+    return ys;
+}
+void MACE::_penalize_failures(MatrixXd& ys) const
+{
+    // A failed evaluation is recorded with the worst objective seen so far
+    // and all the constraints violated, instead of stopping the optimization
+    vector<long> failed;
+    for(long i = 0; i < ys.cols(); ++i)
+        if(not ys.col(i).allFinite())
+            failed.push_back(i);
+    if(failed.empty())
+        return;
+    VectorXd penalty(_num_spec);
+    for(size_t k = 0; k < _num_spec; ++k)
+    {
+        double worst = -1 * INF;
+        if((size_t)_dby.rows() == _num_spec)
+            for(long i = 0; i < _dby.cols(); ++i)
+                worst = max(worst, _dby(k, i));
+        for(long i = 0; i < ys.cols(); ++i)
+            if(std::isfinite(ys(k, i)))
+                worst = max(worst, ys(k, i));
+        if(k == 0 and not std::isfinite(worst))
+        {
+            _fatal("All the evaluations failed");
+        }
+        penalty(k) = k == 0 ? worst : max(worst, 0.0) + 1;
+    }
+    for(long i : failed)
+        ys.col(i) = penalty;
+    BOOST_LOG_TRIVIAL(warning) << failed.size() << " evaluations failed, recorded as " << penalty.transpose();
+}
+void MACE::_update_best(const MatrixXd& scaled_xs, const MatrixXd& ys)
+{
+    bool no_improve = true;
+    for(long i = 0; i < ys.cols(); ++i)
     {
         if(_better(ys.col(i), _best_y))
         {
@@ -81,32 +241,27 @@ MatrixXd MACE::_run_func(const MatrixXd& xs)
         ++_no_improve_counter;
     else
         _no_improve_counter = 0;
-    const auto t2       = chrono::high_resolution_clock::now();
-    const double t_eval = static_cast<double>(chrono::duration_cast<milliseconds>(t2 -t1).count()) / 1000.0;
-    BOOST_LOG_TRIVIAL(info) << "Time for " << num_pnts << " evaluations: " << t_eval << " sec";
-    _eval_counter += num_pnts;
-    return ys;
+    _eval_counter += ys.cols();
 }
 MACE::~MACE()
 {
     delete _gp;
+    if(_trace != nullptr and _trace->num_dropped() > 0)
+        BOOST_LOG_TRIVIAL(warning) << _trace->num_dropped() << " records are dropped from the trace";
 }
-void MACE::_init_boost_log() const
+void MACE::_init_boost_log(bool append)
 {
     boost::log::add_common_attributes();
-#ifndef MYDEBUG
-    boost::log::add_file_log(boost::log::keywords::file_name = _log_name, boost::log::keywords::auto_flush = true);
-    boost::log::core::get()->set_filter
-    (
-        boost::log::trivial::severity >= boost::log::trivial::info
-    );
-#else
-    boost::log::add_file_log(
-            boost::log::keywords::file_name  = _log_name,
-            boost::log::keywords::auto_flush = true
-            // boost::log::keywords::format     = "[%TimeStamp%]:\n%Message%"
-    );
-#endif
+    _log_sink.reset(); // the file is closed before it is opened again
+    _log_sink.reset(new LogSink(_log_name, _log_async, append, _log_study));
+    _log_sink->set_level(_log_level);
+}
+void MACE::_log_data(const string& tag, const MatrixXd& data) const
+{
+    if(_trace != nullptr)
+        _trace->write(tag, _eval_counter, data);
+    else
+        BOOST_LOG_TRIVIAL(info) << tag << ":\n" << data;
 }
 bool MACE::_is_feas(const VectorXd& v) const
 {
@@ -153,38 +308,86 @@ void MACE::initialize(const MatrixXd& dbx, const MatrixXd& dby)
     // User can provide data for initializing
     if(_gp != nullptr)
     {
-        BOOST_LOG_TRIVIAL(error) << "GP is already created!" << endl;
-        exit(EXIT_FAILURE);
+        _fatal("GP is already created!");
     }
-    MYASSERT(static_cast<size_t>(dbx.rows()) == _dim);
-    MYASSERT(static_cast<size_t>(dby.rows()) == _num_spec);
-    MYASSERT(dbx.cols() == dby.cols());
-    MYASSERT((dbx.array() <= _ub.replicate(1, dbx.cols()).array()).all());
-    MYASSERT((dbx.array() >= _lb.replicate(1, dbx.cols()).array()).all());
+    MACE_CHECK(static_cast<size_t>(dbx.rows()) == _dim);
+    MACE_CHECK(static_cast<size_t>(dby.rows()) == _num_spec);
+    MACE_CHECK(dbx.cols() == dby.cols());
+    MACE_CHECK((dbx.array() <= _ub.replicate(1, dbx.cols()).array()).all());
+    MACE_CHECK((dbx.array() >= _lb.replicate(1, dbx.cols()).array()).all());
 
-    MatrixXd scaled_dbx = _unscale(dbx); // scaled from [lb, ub] to [_scaled_lb, _scaled_ub]
-    if (dbx.cols() < 2)
+    if(! dby.allFinite())
     {
-        BOOST_LOG_TRIVIAL(error) << "Size of initial sampling is less than 2" << endl;
-        exit(EXIT_FAILURE);
+        _fatal("There are INF|NAN values in dby");
     }
-    if(! dby.allFinite())
+    _dbx = _unscale(dbx); // scaled from [lb, ub] to [_scaled_lb, _scaled_ub]
+    _dby = dby;
+    _init_from_db(_dbx.cols());
+}
+void MACE::initialize_binary(string db_file, size_t max_gp_size)
+{
+    // The records are streamed from the memory-mapped file directly into
+    // `_dbx` and `_dby`, records out of [lb, ub] or with INF|NAN values are
+    // skipped
+    if(_gp != nullptr)
     {
-        BOOST_LOG_TRIVIAL(error) << "There are INF|NAN values in dby" << endl;
-        exit(EXIT_FAILURE);
+        _fatal("GP is already created!");
     }
-    const size_t best_id = _find_best(dby);
-    _best_x              = dbx.col(best_id);
-    _best_y              = dby.col(best_id);
+    try
+    {
+        BinaryDB db(db_file);
+        if(db.dim() != _dim or db.num_spec() != _num_spec)
+            throw runtime_error("Dimension of " + db_file + " does not match the problem");
+        _dbx.resize(_dim, db.size());
+        _dby.resize(_num_spec, db.size());
+        size_t num_valid = 0;
+        for(size_t i = 0; i < db.size(); ++i)
+        {
+            const Map<const VectorXd> x(db.x(i), _dim);
+            const Map<const VectorXd> y(db.y(i), _num_spec);
+            if(not (x.allFinite() and y.allFinite() and (x.array() >= _lb.array()).all() and (x.array() <= _ub.array()).all()))
+                continue;
+            _dbx.col(num_valid) = (x - _b).cwiseQuotient(_a);
+            _dby.col(num_valid) = y;
+            ++num_valid;
+        }
+        if(num_valid < db.size())
+            BOOST_LOG_TRIVIAL(warning) << db.size() - num_valid << " invalid records in " << db_file << " are skipped";
+        _dbx.conservativeResize(NoChange, num_valid);
+        _dby.conservativeResize(NoChange, num_valid);
+    }
+    catch(const exception& e)
+    {
+        _fatal("Fail to load " + db_file + ": " + e.what());
+    }
+    _init_from_db(max_gp_size == 0 ? _dbx.cols() : max_gp_size);
+}
+void MACE::_init_from_db(size_t max_gp_size)
+{
+    if (_dbx.cols() < 2)
+    {
+        _fatal("Size of initial sampling is less than 2");
+    }
+    const size_t best_id = _find_best(_dby);
+    _best_x              = _rescale(_dbx.col(best_id));
+    _best_y              = _dby.col(best_id);
     _have_feas           = _is_feas(_best_y);
-    _gp                  = new GP(scaled_dbx, dby.transpose());
     _no_improve_counter  = 0;
+    _dbx_index.build(_dbx);
+    _rebuild_gp(max_gp_size);
     _hyps                = _gp->get_default_hyps();
-    _gp->set_noise_free(_noise_free);
-    if(not _noise_free)
-        _gp->set_noise_lower_bound(_noise_lvl);
-    BOOST_LOG_TRIVIAL(info) << "Initial DBX:\n" << dbx << endl;
-    BOOST_LOG_TRIVIAL(info) << "Initial DBY:\n" << dby << endl;
+    if(_dbx.cols() <= 100)
+    {
+        _log_data("Initial DBX", _rescale(_dbx));
+        _log_data("Initial DBY", _dby);
+    }
+    else
+    {
+        BOOST_LOG_TRIVIAL(info) << "Initial data: " << _dbx.cols() << " points, " << _gp->train_in().cols() << " used by GP";
+        BOOST_LOG_TRIVIAL(info) << "Initial best x: " << _best_x.transpose();
+        BOOST_LOG_TRIVIAL(info) << "Initial best y: " << _best_y.transpose();
+    }
+    _prof.reset();
 }
 void MACE::initialize(size_t init_size)
 {
@@ -193,6 +396,107 @@ void MACE::initialize(size_t init_size)
     const MatrixXd dby = _run_func(dbx);
     initialize(_rescale(dbx), dby);
 }
+void MACE::save_checkpoint(string path) const
+{
+    CheckpointWriter writer(path);
+    writer.write(string("MACE checkpoint"));
+    writer.write(static_cast<size_t>(2)); // version
+    writer.write(_dim);
+    writer.write(_num_spec);
+    writer.write(_eval_counter);
+    writer.write(_no_improve_counter);
+    writer.write(static_cast<size_t>(_have_feas));
+    writer.write(_seed);
+    writer.write(_kappa);
+    writer.write(_best_x);
+    writer.write(_best_y);
+    writer.write(_hyps);
+    writer.write(_nlz);
+    writer.write(_dbx);
+    writer.write(_dby);
+    stringstream engine_state;
+    engine_state << _engine;
+    writer.write(engine_state.str());
+    writer.write(_gp_idx.size()); // since version 2
+    for(size_t idx : _gp_idx)
+        writer.write(idx);
+    writer.commit();
+}
+void MACE::_save_checkpoint() const
+{
+    if(_checkpoint_file.empty())
+        return;
+    try
+    {
+        save_checkpoint(_checkpoint_file);
+    }
+    catch(const exception& e)
+    {
+        // A failed checkpoint should not stop the optimization
+        BOOST_LOG_TRIVIAL(warning) << e.what();
+    }
+}
+void MACE::resume(string path)
+{
+    // Restore the state saved by `save_checkpoint`, no evaluation is
+    // repeated, the GP is created from the saved data with the saved
+    // hyperparameters, in sparse mode on the saved subset, so that the
+    // resumed run neither trains on all the data nor selects another subset
+    if(_gp != nullptr)
+    {
+        _fatal("GP is already created!");
+    }
+    size_t version = 0;
+    try
+    {
+        CheckpointReader reader(path);
+        if(reader.read_string() != "MACE checkpoint" or (version = reader.read_size()) < 1 or version > 2)
+            throw runtime_error(path + " is not a MACE checkpoint");
+        if(reader.read_size() != _dim or reader.read_size() != _num_spec)
+            throw runtime_error("Dimension of " + path + " does not match the problem");
+        _eval_counter       = reader.read_size();
+        _no_improve_counter = reader.read_size();
+        _have_feas          = reader.read_size() != 0;
+        _seed               = reader.read_double();
+        _kappa              = reader.read_double();
+        _best_x             = reader.read_matrix();
+        _best_y             = reader.read_matrix();
+        _hyps               = reader.read_matrix();
+        _nlz                = reader.read_matrix();
+        _dbx                = reader.read_matrix();
+        _dby                = reader.read_matrix();
+        stringstream engine_state(reader.read_string());
+        engine_state >> _engine;
+        MACE_CHECK(static_cast<size_t>(_dbx.rows()) == _dim);
+        MACE_CHECK(static_cast<size_t>(_dby.rows()) == _num_spec);
+        MACE_CHECK(_dbx.cols() == _dby.cols());
+        _gp_idx.clear();
+        if(version >= 2)
+        {
+            const size_t num_idx = reader.read_size();
+            if(num_idx > (size_t)_dbx.cols())
+                throw runtime_error("Invalid GP subset in " + path);
+            for(size_t i = 0; i < num_idx; ++i)
+            {
+                _gp_idx.push_back(reader.read_size());
+                if(_gp_idx.back() >= (size_t)_dbx.cols())
+                    throw runtime_error("Invalid GP subset in " + path);
+            }
+        }
+    }
+    catch(const exception& e)
+    {
+        _fatal(string("Fail to resume: ") + e.what());
+    }
+    _dbx_index.build(_dbx);
+    if(version == 1)
+        _rebuild_gp(); // no subset is saved
+    else
+        _set_gp_data(_gp_idx.empty() ? _seq_idx(_dbx.cols()) : _gp_idx);
+    BOOST_LOG_TRIVIAL(info) << "Resumed from " << path << " with " << _eval_counter << " evaluations";
+    _prof.reset();
+    BOOST_LOG_TRIVIAL(info) << "Best_y: " << _best_y.transpose();
+}
 size_t MACE::_find_best(const MatrixXd& dby) const
 {
     vector<size_t> idxs = _seq_idx(dby.cols());
@@ -232,8 +536,12 @@ MatrixXd MACE::_doe(size_t num)
     }
     else
     {
-        sampled.setRandom();
-        sampled = 0.5 * (sampled.array() + 1);
+        // drawn from `_engine` instead of `std::rand`, so that the sampling
+        // continues the same sequence after `resume`
+        uniform_real_distribution<double> unif(0, 1);
+        for(long i = 0; i < sampled.cols(); ++i)
+            for(long j = 0; j < sampled.rows(); ++j)
+                sampled(j, i) = unif(_engine);
     }
 
     // transform points from [0, 1] to [lb, ub]
@@ -248,6 +556,8 @@ MatrixXd MACE::_doe(size_t num)
 void MACE::set_init_num(size_t n) { _num_init = n; }
 void MACE::set_max_eval(size_t n) { _max_eval = n; }
 void MACE::set_batch(size_t n) { _batch_size = n; }
+void MACE::set_batch_func(BatchObj f) { _batch_func = f; }
+void MACE::set_speculation(double factor) { _speculate = factor; }
 void MACE::set_force_select_hyp(bool f) { _force_select_hyp = f; }
 void MACE::set_tol_no_improvement(size_t n) { _tol_no_improvement = n; }
 void MACE::set_eval_fixed(size_t n) { _eval_fixed = n; }
@@ -256,7 +566,62 @@ void MACE::set_seed(size_t s)
     _seed = s;
     _engine.seed(_seed); 
 }
+void MACE::set_throw_on_error(bool flag) { _throw_on_error = flag; }
+void MACE::_fatal(const string& msg) const
+{
+    BOOST_LOG_TRIVIAL(error) << msg;
+    if(_throw_on_error)
+        throw runtime_error(msg);
+    exit(EXIT_FAILURE);
+}
 void MACE::set_gp_noise_lower_bound(double lvl) { _noise_lvl = lvl; }
+void MACE::set_hyp_starts(size_t n) { _hyp_starts = n; }
+void MACE::set_checkpoint(string path) { _checkpoint_file = path; }
+void MACE::set_log_async(bool flag)
+{
+    if(flag == _log_async)
+        return;
+    _log_async = flag;
+    _init_boost_log(true);
+}
+void MACE::set_log_study(string study)
+{
+    _log_study = study;
+    _init_boost_log(true);
+}
+void MACE::set_log_level(boost::log::trivial::severity_level level)
+{
+    _log_level = level;
+    _log_sink->set_level(level);
+}
+void MACE::set_trace(string path)
+{
+    try
+    {
+        _trace.reset(new TraceWriter(path));
+    }
+    catch(const exception& e)
+    {
+        _fatal(e.what());
+    }
+}
+void MACE::set_profile(string path)
+{
+    try
+    {
+        _prof.open(path);
+    }
+    catch(const exception& e)
+    {
+        _fatal(e.what());
+    }
+}
+void MACE::set_sparse_gp(bool flag, size_t threshold, size_t num_inducing)
+{
+    _sparse_gp        = flag;
+    _sparse_threshold = threshold;
+    _num_inducing     = num_inducing;
+}
 void MACE::set_mo_record(bool r) {_mo_record = r;}
 void MACE::set_mo_gen(size_t gen){_mo_gen = gen;}
 void MACE::set_mo_np(size_t np){_mo_np = np;}
@@ -273,20 +638,19 @@ void MACE::optimize()
         optimize_one_step();
     }
 }
-MatrixXd MACE::_adaptive_sampling()
+MatrixXd MACE::_adaptive_sampling(size_t num)
 {
-    assert(_gp != nullptr);
-    assert(_gp->trained());
-    GP tmp_gp(_gp->train_in(), _gp->train_out());
-    tmp_gp.set_fixed(true);
-    tmp_gp.set_noise_free(_noise_free);
-    tmp_gp.set_noise_lower_bound(_noise_lvl);
-    MatrixXd one_step_eval_x = MatrixXd(_dim, _batch_size);
-    for(size_t i = 0; i < _batch_size; ++i)
+    MACE_CHECK(_gp != nullptr);
+    MACE_CHECK(_gp->trained());
+    Profiler::Scope scope(_prof, Profiler::Adaptive);
+    RefitFantasyGP tmp_gp(_gp, _noise_free, _noise_lvl);
+    MatrixXd one_step_eval_x = MatrixXd(_dim, num);
+    for(size_t i = 0; i < num; ++i)
     {
-        tmp_gp.train(_gp->get_hyp());
         MVMO::MVMO_Obj f = [&](const VectorXd& x)->double{
             double gpy, gps2;
+            _prof.add(Profiler::MVMOEval);
+            _prof.add(Profiler::Predict);
             tmp_gp.predict(0, x, gpy, gps2);
             return -1 * gps2;
         };
@@ -297,15 +661,16 @@ MatrixXd MACE::_adaptive_sampling()
         mvmo_opt.set_archive_size(25);
         mvmo_opt.optimize();
         VectorXd new_x = mvmo_opt.best_x();
-        MatrixXd new_gpy, new_gps2;
-        tmp_gp.predict(new_x, new_gpy, new_gps2);
-        tmp_gp.add_data(new_x, new_gpy);
+        if(i + 1 < num)
+            tmp_gp.add_fantasy(new_x);
         one_step_eval_x.col(i) = new_x;
     }
     return one_step_eval_x;
 }
 void MACE::blcb()
 {
+    if(_num_spec > 1)
+        BOOST_LOG_TRIVIAL(warning) << "BLCB ignores the constraints";
     if(_gp == nullptr)
         initialize(_num_init);
     while(_eval_counter < _max_eval)
@@ -313,7 +678,9 @@ void MACE::blcb()
         _eval_x = blcb_one_step();
         _eval_y = _run_func(_eval_x);
         _print_log();
-        _gp->add_data(_eval_x, _eval_y.transpose());
+        _add_data(_eval_x, _eval_y);
+        _save_checkpoint();
+        _prof.record(_eval_counter);
     }
 }
 MatrixXd MACE::blcb_one_step() // one iteration of BO, so that BO could be used as a plugin of other application
@@ -321,37 +688,35 @@ MatrixXd MACE::blcb_one_step() // one iteration of BO, so that BO could be used
     // Train GP model
     if(_gp == nullptr)
     {
-        BOOST_LOG_TRIVIAL(error) << "GP not initialized";
-        exit(EXIT_FAILURE);
+        _fatal("GP not initialized");
     }
     
     if(not _have_feas)
     {
-        BOOST_LOG_TRIVIAL(error) << "BLCB method is only used for unconstrained optimization";
-        exit(EXIT_FAILURE);
+        _fatal("BLCB method is only used for unconstrained optimization");
     }
     else
     {
+        Profiler::Scope scope(_prof, Profiler::Adaptive);
         _set_kappa();
         _train_GP();
-        GP tmp_gp(_gp->train_in(), _gp->train_out());
-        tmp_gp.set_fixed(true);
-        tmp_gp.set_noise_free(_noise_free);
-        tmp_gp.set_noise_lower_bound(_noise_lvl);
+        RefitFantasyGP tmp_gp(_gp, _noise_free, _noise_lvl);
         MatrixXd one_step_eval_x = MatrixXd(_dim, _batch_size);
         for(size_t i = 0; i < _batch_size; ++i)
         {
-            tmp_gp.train(_gp->get_hyp());
             MVMO::MVMO_Obj f = [&](const VectorXd& x)->double{
                 double gpy, gps2, gps;
+                _prof.add(Profiler::MVMOEval);
+                _prof.add(Profiler::Predict);
                 tmp_gp.predict(0, x, gpy, gps2);
                 gps = sqrt(gps2);
                 double lcb = gpy - _kappa * gps;
                 return lcb;
             };
-            NLopt_wrapper::func fls = [&](const VectorXd& x, VectorXd& g)->double{
+            auto fls = [&](const NLopt_wrapper::Point& x, NLopt_wrapper::Grad& g)->double{
                 double gpy, gps2, gps;
                 VectorXd grad_y, grad_s2, grad_s;
+                _prof.add(Profiler::Predict);
                 tmp_gp.predict_with_grad(0, x, gpy, gps2, grad_y, grad_s2);
                 gps    = sqrt(gps2);
                 grad_s = 0.5 * grad_s2 / gps;
@@ -368,9 +733,8 @@ MatrixXd MACE::blcb_one_step() // one iteration of BO, so that BO could be used
             mvmo_opt.set_archive_size(25);
             mvmo_opt.optimize(anchor);
             VectorXd new_x = _msp(fls, mvmo_opt.best_x());
-            MatrixXd new_gpy, new_gps2;
-            tmp_gp.predict(new_x, new_gpy, new_gps2);
-            tmp_gp.add_data(new_x, new_gpy);
+            if(i + 1 < _batch_size)
+                tmp_gp.add_fantasy(new_x);
             one_step_eval_x.col(i) = new_x;
         }
         one_step_eval_x = _adjust_x(one_step_eval_x);
@@ -382,63 +746,286 @@ void MACE::optimize_one_step() // one iteration of BO, so that BO could be used
     // Train GP model
     if(_gp == nullptr)
     {
-        BOOST_LOG_TRIVIAL(error) << "GP not initialized";
-        exit(EXIT_FAILURE);
+        _fatal("GP not initialized");
     }
     _train_GP();
+    _eval_x = _propose(_batch_size);
+    _eval_y = _run_func(_eval_x);
+    _print_log();
+    _add_data(_eval_x, _eval_y);
+    _save_checkpoint();
+    _prof.record(_eval_counter);
+}
+void MACE::optimize_async()
+{
+    // Asynchronous version of `optimize`: the last thread owns the model, the
+    // other `_batch_size` threads only run the evaluations. Whenever an
+    // evaluation finishes, the model thread adds the result to the GP and
+    // proposes a new point with the outcomes of the pending points fantasized
+    // by the GP posterior mean, while the other evaluations keep running, so
+    // that no evaluation waits for the slowest simulation, and no thread waits
+    // for the proposal of another one
+    if(_gp == nullptr)
+        initialize(_num_init);
+    typedef pair<VectorXd, VectorXd> Result;
+    mutex mtx;
+    condition_variable work_cv;   // a point is ready, or the optimization is finished
+    condition_variable result_cv; // an evaluation is finished
+    deque<VectorXd> ready;        // proposed and not started
+    map<int, VectorXd> running;   // by thread
+    deque<Result> results;        // evaluated and not added to the GP
+    size_t dispatched = _eval_counter;
+    bool finished     = false;
+    auto evaluate = [&](const VectorXd& x) -> VectorXd {
+        const auto t1       = chrono::high_resolution_clock::now();
+        const VectorXd y    = _run_one(_rescale(x));
+        const auto t2       = chrono::high_resolution_clock::now();
+        const double t_eval = static_cast<double>(chrono::duration_cast<milliseconds>(t2 -t1).count()) / 1000.0;
+        _prof.add_time(Profiler::Eval, t2 - t1);
+        BOOST_LOG_TRIVIAL(info) << "Time for evaluation in thread " << omp_get_thread_num() << ": " << t_eval << " sec";
+        return y;
+    };
+#pragma omp parallel num_threads(_batch_size + 1)
+    {
+        // fewer threads than requested may be granted, without any evaluation
+        // thread, the model thread evaluates the points itself
+        const int num_slots = omp_get_num_threads() - 1;
+        const int tid       = omp_get_thread_num();
+        unique_lock<mutex> lock(mtx);
+        if(tid == num_slots)
+        {
+            bool need_train = true;
+            while(true)
+            {
+                if(not results.empty())
+                {
+                    deque<Result> absorbed;
+                    absorbed.swap(results);
+                    lock.unlock();
+                    for(const Result& r : absorbed)
+                    {
+                        _eval_x = r.first;
+                        _eval_y = r.second;
+                        _penalize_failures(_eval_y);
+                        _update_best(_rescale(_eval_x), _eval_y);
+                        _print_log();
+                        _add_data(_eval_x, _eval_y);
+                        _save_checkpoint();
+                        _prof.record(_eval_counter);
+                    }
+                    need_train = true;
+                    lock.lock();
+                }
+                else if(dispatched < _max_eval and ready.size() + running.size() < (size_t)max(1, num_slots))
+                {
+                    MatrixXd pending_x(_dim, ready.size() + running.size());
+                    long idx = 0;
+                    for(const VectorXd& x : ready)
+                        pending_x.col(idx++) = x;
+                    for(auto& p : running)
+                        pending_x.col(idx++) = p.second;
+                    ++dispatched;
+                    lock.unlock();
+                    if(need_train)
+                    {
+                        _train_GP();
+                        need_train = false;
+                    }
+                    const VectorXd x = _propose(1, pending_x).col(0);
+                    BOOST_LOG_TRIVIAL(info) << "Proposed X: " << _rescale(x).transpose();
+                    if(num_slots == 0)
+                    {
+                        const VectorXd y = evaluate(x);
+                        lock.lock();
+                        results.emplace_back(x, y);
+                    }
+                    else
+                    {
+                        lock.lock();
+                        ready.push_back(x);
+                        work_cv.notify_one();
+                    }
+                }
+                else if(dispatched >= _max_eval and ready.empty() and running.empty())
+                    break;
+                else
+                    result_cv.wait(lock);
+            }
+            finished = true;
+            work_cv.notify_all();
+        }
+        else
+        {
+            while(true)
+            {
+                work_cv.wait(lock, [&]() { return finished or not ready.empty(); });
+                if(ready.empty())
+                    break;
+                const VectorXd x = ready.front();
+                ready.pop_front();
+                running[tid] = x;
+                lock.unlock();
+                const VectorXd y = evaluate(x);
+                lock.lock();
+                running.erase(tid);
+                results.emplace_back(x, y);
+                result_cv.notify_one();
+            }
+        }
+    }
+}
+MatrixXd MACE::_propose(size_t num, const MatrixXd& pending_x)
+{
+    if(pending_x.cols() == 0)
+        return _propose(num);
+
+    // Pending points are hallucinated with their predicted values, the same
+    // way as `_adaptive_sampling` does
+    RefitFantasyGP tmp_gp(_gp, _noise_free, _noise_lvl);
+    tmp_gp.add_fantasy(pending_x);
+
+    // the real GP is also restored when the proposal throws, see
+    // `set_throw_on_error`
+    struct Restore
+    {
+        MACE& mace;
+        GP*   real_gp;
+        ~Restore()
+        {
+            mace._gp        = real_gp;
+            mace._pending_x = MatrixXd(mace._dim, 0);
+        }
+    } restore{*this, _gp};
+    _gp        = tmp_gp.gp();
+    _pending_x = pending_x;
+    return _propose(num);
+}
+MatrixXd MACE::ask(size_t num)
+{
+    MatrixXd xs;
+    if(_gp == nullptr)
+        xs = _doe(num);
+    else
+    {
+        if(_told)
+        {
+            _train_GP();
+            _told = false;
+        }
+        xs = _propose(num, _asked);
+    }
+    _asked.conservativeResize(NoChange, _asked.cols() + num);
+    _asked.rightCols(num) = xs;
+    return _rescale(xs);
+}
+void MACE::tell(const MatrixXd& xs, const MatrixXd& ys)
+{
+    if((size_t)xs.rows() != _dim or (size_t)ys.rows() != _num_spec or xs.cols() != ys.cols())
+        throw invalid_argument("Size of the told data does not match the problem");
+    if(not ((xs.array() >= _lb.replicate(1, xs.cols()).array()).all() and (xs.array() <= _ub.replicate(1, xs.cols()).array()).all()))
+        throw invalid_argument("Told points are out of bounds");
+    if(not (xs.allFinite() and ys.allFinite()))
+        throw invalid_argument("There are INF|NAN values in the told data");
+
+    // the told points are no longer pending, points that are not asked are
+    // also accepted
+    const MatrixXd scaled_xs = _unscale(xs);
+    for(long i = 0; i < scaled_xs.cols(); ++i)
+    {
+        for(long j = 0; j < _asked.cols(); ++j)
+        {
+            if((_asked.col(j) - scaled_xs.col(i)).squaredNorm() < 1e-12)
+            {
+                _asked.col(j) = _asked.col(_asked.cols() - 1);
+                _asked.conservativeResize(NoChange, _asked.cols() - 1);
+                break;
+            }
+        }
+    }
+    _log_data("X", xs.transpose());
+    _update_best(xs, ys);
+    _eval_x = scaled_xs;
+    _eval_y = ys;
+    _told   = true;
+    if(_gp == nullptr)
+    {
+        // the GP is created when the initial sampling is told
+        const long n = _dbx.cols();
+        _dbx.conservativeResize(_dim, n + xs.cols());
+        _dby.conservativeResize(_num_spec, n + ys.cols());
+        _dbx.rightCols(xs.cols()) = scaled_xs;
+        _dby.rightCols(ys.cols()) = ys;
+        _log_data("Eval", ys.transpose());
+        if(_dbx.cols() >= 2 and (size_t)_dbx.cols() >= _num_init)
+            _init_from_db(_dbx.cols());
+        return;
+    }
+    _print_log();
+    _add_data(_eval_x, _eval_y);
+    _save_checkpoint();
+    _prof.record(_eval_counter);
+}
+MatrixXd MACE::_propose(size_t num)
+{
     _set_best_posterior_mean();
     BOOST_LOG_TRIVIAL(trace) << "Best posterior: " << _best_posterior_y.transpose();
     
     // XXX: This is a fast-prototype, possible improvements includes:
-    // 1. Use gradient-based MSP to optimize the PF
-    // 2. More advanced techniques to incorporate constraints
-    // 3. More advanced techniques to transform the LCB function
-    
-    // TODO: MSP for PF optimization
+    // 1. More advanced techniques to incorporate constraints
+    // 2. More advanced techniques to transform the LCB function
     MOO::ObjF neg_log_pf = [&](const VectorXd xs)->VectorXd{
         VectorXd obj(1);
         obj << -1 * _log_pf(xs);
         return obj;
     };
+    MatrixXd proposed;
     if(not _have_feas)
     {
         // If no feasible solution is found, optimize PF firstly
         MOO pf_optimizer(neg_log_pf, 1, VectorXd::Constant(_dim, 1, _scaled_lb), VectorXd::Constant(_dim, 1, _scaled_ub));
         _moo_config(pf_optimizer);
-        pf_optimizer.moo();
-        MYASSERT(pf_optimizer.pareto_set().cols() == 1);
-        _eval_x = pf_optimizer.pareto_set();
-        _eval_x = _adjust_x(_eval_x);
-        _eval_y = _run_func(_eval_x);
+        {
+            Profiler::Scope scope(_prof, Profiler::MultiObj);
+            pf_optimizer.moo();
+        }
+        MACE_CHECK(pf_optimizer.pareto_set().cols() == 1);
+
+        // the PF optimized by MOO is refined by gradient-based MSP
+        auto neg_log_pf_grad = [&](const NLopt_wrapper::Point& x, NLopt_wrapper::Grad& grad)->double{
+            VectorXd g;
+            const double val = -1 * _log_pf(x, g);
+            grad = -1 * g;
+            return val;
+        };
+        proposed = _msp(neg_log_pf_grad, pf_optimizer.pareto_set(), nlopt::LD_LBFGS, 40);
     }
     else
     {
         if(_no_improve_counter > 0 and _no_improve_counter % _tol_no_improvement == 0)
         {
-            // XXX: for unconstrained problem
-            assert(_num_spec == 1);
+            // the uncertainty of the objective is sampled, also for
+            // constrained problems
             BOOST_LOG_TRIVIAL(trace) << "Sample points with max uncertainty";
-            _eval_x = _adaptive_sampling();
+            proposed = _adaptive_sampling(num);
         }
         else
         {
             // If there are feasible solutions, perform MOO to (EI, LCB) functions
             _set_kappa();
             MOO::ObjF mo_acq = [&](const VectorXd xs)->VectorXd{
-                VectorXd objs(_acq_pool.size());
-                vector<double> acq_vals;
-                for(auto name : _acq_pool)
-                    acq_vals.push_back(_acq(name, xs));
-                return -1*convert(acq_vals);
+                return -1 * _acq_pool_vals(xs);
             };
             MOO acq_optimizer(mo_acq, _acq_pool.size(), VectorXd::Constant(_dim, 1, _scaled_lb), VectorXd::Constant(_dim, 1, _scaled_ub));
             _moo_config(acq_optimizer);
             acq_optimizer.set_anchor(_set_anchor());
             acq_optimizer.set_crowding_space(MOO::CrowdingSpace::Output);
-            acq_optimizer.moo();
+            {
+                Profiler::Scope scope(_prof, Profiler::MultiObj);
+                acq_optimizer.moo();
+            }
             MatrixXd ps = acq_optimizer.pareto_set();
             MatrixXd pf = acq_optimizer.pareto_front();
-            _eval_x     = _select_candidate(ps, pf);
+            proposed    = _select_candidate(ps, pf, num);
 #ifdef MYDEBUG
             BOOST_LOG_TRIVIAL(trace) << "Pareto set:\n"   << _rescale(ps).transpose() << endl;
             BOOST_LOG_TRIVIAL(trace) << "Pareto front:\n" << pf.transpose() << endl;
@@ -451,36 +1038,54 @@ void MACE::optimize_one_step() // one iteration of BO, so that BO could be used
             }
             true_global = _unscale(true_global);
             MatrixXd y_glb, s2_glb;
-            _gp->predict(true_global, y_glb, s2_glb);
+            _gp_predict(true_global, y_glb, s2_glb);
             VectorXd acq_glb = mo_acq(true_global);
             BOOST_LOG_TRIVIAL(debug) << "True global: "          << _rescale(true_global).transpose();
             BOOST_LOG_TRIVIAL(debug) << "GPY for true global: "  << y_glb;
             BOOST_LOG_TRIVIAL(debug) << "GPS for true global: "  << s2_glb.cwiseSqrt();
             BOOST_LOG_TRIVIAL(debug) << "Acq for true global: "  << acq_glb.transpose();
-            for(long i = 0; i < _eval_x.cols(); ++i)
+            const MatrixXd acq_proposed = -1 * _acq_pool_vals(proposed);
+            for(long i = 0; i < proposed.cols(); ++i)
             {
-                BOOST_LOG_TRIVIAL(debug) << "Acq for _eval_x: " << mo_acq(_eval_x.col(i)).transpose()
-                    << ", distance to true global: " << (_eval_x.col(i) - true_global).lpNorm<2>();
+                BOOST_LOG_TRIVIAL(debug) << "Acq for proposed x: " << acq_proposed.col(i).transpose()
+                    << ", distance to true global: " << (proposed.col(i) - true_global).lpNorm<2>();
             }
 #endif
         }
-        _eval_x = _adjust_x(_eval_x);
-        _eval_y = _run_func(_eval_x);
     }
-    _print_log();
-    _gp->add_data(_eval_x, _eval_y.transpose());
+    return _adjust_x(proposed);
 }
 void MACE::_print_log()
 {
-    MatrixXd pred_y, pred_s2;
-    _gp->predict(_eval_x, pred_y, pred_s2);
-    BOOST_LOG_TRIVIAL(info) << "Pred-S-Eval:";
-    for(long i = 0; i < _eval_x.cols(); ++i)
+    // the predictions are only made when they are recorded
+    const bool record_pred = _trace != nullptr or _log_level <= boost::log::trivial::info;
+    if(_gp->trained() and record_pred)
     {
-        MatrixXd record(3, _num_spec);
-        record << pred_y.row(i), pred_s2.row(i).cwiseSqrt(), _eval_y.col(i).transpose();
-        BOOST_LOG_TRIVIAL(info) << record;
-        BOOST_LOG_TRIVIAL(info) << "-----";
+        MatrixXd pred_y, pred_s2;
+        _gp_predict(_eval_x, pred_y, pred_s2);
+        if(_trace != nullptr)
+        {
+            MatrixXd record(_eval_x.cols(), 3 * _num_spec);
+            record << pred_y, pred_s2.cwiseSqrt(), _eval_y.transpose();
+            _trace->write("Pred-S-Eval", _eval_counter, record);
+        }
+        else
+        {
+            BOOST_LOG_TRIVIAL(info) << "Pred-S-Eval:";
+            for(long i = 0; i < _eval_x.cols(); ++i)
+            {
+                MatrixXd record(3, _num_spec);
+                record << pred_y.row(i), pred_s2.row(i).cwiseSqrt(), _eval_y.col(i).transpose();
+                BOOST_LOG_TRIVIAL(info) << record;
+                BOOST_LOG_TRIVIAL(info) << "-----";
+            }
+        }
+    }
+    else if(not _gp->trained())
+    {
+        // In asynchronous mode, the GP may have absorbed other finished
+        // evaluations and has not been re-trained yet
+        _log_data("Eval", _eval_y.transpose());
     }
     BOOST_LOG_TRIVIAL(info) << "Kappa: " << _kappa;
     BOOST_LOG_TRIVIAL(info) << "Best_y: "         << _best_y.transpose();
@@ -490,13 +1095,140 @@ void MACE::_print_log()
 }
 MatrixXd MACE::_slice_matrix(const MatrixXd& m, const vector<size_t>& idxs) const
 {
-    MYASSERT((long)*max_element(idxs.begin(), idxs.end()) < m.cols());
+    MACE_CHECK((long)*max_element(idxs.begin(), idxs.end()) < m.cols());
     MatrixXd sm(m.rows(), idxs.size());
     for(size_t i = 0; i < idxs.size(); ++i)
         sm.col(i) = m.col(idxs[i]);
     return sm;
 }
 
+void MACE::_add_data(const MatrixXd& xs, const MatrixXd& ys)
+{
+    // xs are in the scaled space, one column for each point, ys has one
+    // column for each point
+    MACE_CHECK(xs.cols() == ys.cols());
+    const long n = _dbx.cols();
+    _dbx.conservativeResize(NoChange, n + xs.cols());
+    _dby.conservativeResize(NoChange, n + ys.cols());
+    _dbx.rightCols(xs.cols()) = xs;
+    _dby.rightCols(ys.cols()) = ys;
+    for(long i = 0; i < xs.cols(); ++i)
+        _dbx_index.insert(xs.col(i));
+    if(_use_sparse())
+        _update_subset(n, xs.cols());
+    else
+    {
+        _gp_idx.clear();
+        _gp->add_data(xs, ys.transpose());
+    }
+}
+bool MACE::_use_sparse() const
+{
+    return _sparse_gp and (size_t)_dbx.cols() > _sparse_threshold and _num_inducing < (size_t)_dbx.cols();
+}
+void MACE::_rebuild_gp()
+{
+    // The GP is created from all the evaluated points, or, in sparse mode,
+    // from `_num_inducing` points of them as a subset-of-data approximation
+    _rebuild_gp(_use_sparse() ? _num_inducing : _dbx.cols());
+}
+void MACE::_rebuild_gp(size_t max_size)
+{
+    const bool use_subset = (size_t)_dbx.cols() > max_size;
+    _gp_idx = use_subset ? _select_subset(max_size) : vector<size_t>();
+    _set_gp_data(use_subset ? _gp_idx : _seq_idx(_dbx.cols()));
+}
+void MACE::_set_gp_data(const vector<size_t>& idxs)
+{
+    if(idxs.size() < (size_t)_dbx.cols())
+        BOOST_LOG_TRIVIAL(info) << "GP with " << idxs.size() << " of " << _dbx.cols() << " points";
+    delete _gp;
+    _gp = new GP(_slice_matrix(_dbx, idxs), _slice_matrix(_dby, idxs).transpose());
+    _gp->set_noise_free(_noise_free);
+    if(not _noise_free)
+        _gp->set_noise_lower_bound(_noise_lvl);
+}
+void MACE::_update_subset(size_t first, size_t num)
+{
+    // The subset of the sparse mode is only selected from scratch when it is
+    // not maintained yet, afterwards the `num` new points from column `first`
+    // are swapped in, each evicting the most redundant point of the subset,
+    // the one nearest to another point of it, while the best half of the
+    // subset is never evicted. The GP can not remove data, so it is recreated
+    // on the updated subset, and `_train_GP` starts from the current `_hyps`
+    if(_gp_idx.size() != _num_inducing)
+    {
+        _rebuild_gp(_num_inducing);
+        return;
+    }
+    for(size_t i = first; i < first + num; ++i)
+        _gp_idx.push_back(i);
+    const size_t m = _gp_idx.size();
+    vector<size_t> order = _seq_idx(m);
+    stable_sort(order.begin(), order.end(), [&](size_t i1, size_t i2)->bool{
+        return _better(_dby.col(_gp_idx[i1]), _dby.col(_gp_idx[i2]));
+    });
+    vector<bool> keep(m, true);
+    vector<bool> protect(m, false);
+    for(size_t i = 0; i < (_num_inducing + 1) / 2; ++i)
+        protect[order[i]] = true;
+    const MatrixXd sub = _slice_matrix(_dbx, _gp_idx);
+    MatrixXd dist      = -2 * sub.transpose() * sub;
+    dist.colwise()    += sub.colwise().squaredNorm().transpose();
+    dist.rowwise()    += sub.colwise().squaredNorm();
+    dist.diagonal().setConstant(INF);
+    for(size_t evicted = 0; evicted < m - _num_inducing; ++evicted)
+    {
+        long   victim   = -1;
+        double min_dist = INF;
+        for(size_t i = 0; i < m; ++i)
+        {
+            if(not keep[i] or protect[i])
+                continue;
+            double nearest = INF;
+            for(size_t j = 0; j < m; ++j)
+                if(keep[j])
+                    nearest = std::min(nearest, dist(j, i));
+            if(victim < 0 or nearest < min_dist)
+            {
+                victim   = i;
+                min_dist = nearest;
+            }
+        }
+        keep[victim] = false;
+    }
+    vector<size_t> idxs;
+    for(size_t i = 0; i < m; ++i)
+        if(keep[i])
+            idxs.push_back(_gp_idx[i]);
+    _gp_idx = idxs;
+    _set_gp_data(_gp_idx);
+}
+vector<size_t> MACE::_select_subset(size_t m) const
+{
+    // Half of the subset are the best points, so that the GP is accurate
+    // around the optimum, the other half are chosen by greedy farthest point
+    // sampling to cover the whole design space
+    const size_t n = _dbx.cols();
+    MACE_CHECK(m <= n);
+    vector<size_t> sorted_idxs = _seq_idx(n);
+    stable_sort(sorted_idxs.begin(), sorted_idxs.end(), [&](size_t i1, size_t i2)->bool{
+        return _better(_dby.col(i1), _dby.col(i2));
+    });
+    vector<size_t> idxs(sorted_idxs.begin(), sorted_idxs.begin() + (m + 1) / 2);
+    VectorXd min_dist = VectorXd::Constant(n, INF);
+    for(size_t idx : idxs)
+        min_dist = min_dist.cwiseMin((_dbx.colwise() - _dbx.col(idx)).colwise().squaredNorm().transpose());
+    while(idxs.size() < m)
+    {
+        long far_idx;
+        min_dist.maxCoeff(&far_idx);
+        idxs.push_back(far_idx);
+        min_dist = min_dist.cwiseMin((_dbx.colwise() - _dbx.col(far_idx)).colwise().squaredNorm().transpose());
+    }
+    sort(idxs.begin(), idxs.end());
+    return idxs;
+}
 void MACE::_moo_config(MOO& moo_optimizer) const
 {
     moo_optimizer.set_f(_mo_f);
@@ -509,20 +1241,34 @@ void MACE::_moo_config(MOO& moo_optimizer) const
 
 void MACE::_train_GP()
 {
+    Profiler::Scope scope(_prof, Profiler::Train);
     auto train_start = chrono::high_resolution_clock::now();
     _gp->set_fixed(_eval_counter > _eval_fixed);
+    bool trained = false;
     if (_force_select_hyp || (_no_improve_counter > 0 && _no_improve_counter % _tol_no_improvement == 0))
     {
         if(_eval_counter <= _eval_fixed)
         {
             BOOST_LOG_TRIVIAL(info) << "Re-select initial hyp" << endl;
-            _gp->set_fixed(false);
-            _hyps = _gp->select_init_hyp(1000, _hyps);
-            _nlz  = _gp->train(_hyps);
+            _hyps   = _multi_start_hyp(1000);
+            _gp->set_fixed(true);
+            _nlz    = _gp->train(_hyps);
+            trained = true;
             BOOST_LOG_TRIVIAL(info) << _hyps << endl;
         }
     }
-    _nlz  = _gp->train(_hyps);
+    // Training again from the same initial hyperparameters would only repeat
+    // the optimization and the factorization done above
+    if(not trained and _num_spec > 1 and _eval_counter <= _eval_fixed)
+    {
+        // the hyperparameters of each spec are optimized in parallel, the
+        // GP of all the specs is then only factorized
+        _hyps = _train_per_spec(_hyps);
+        _gp->set_fixed(true);
+        _nlz  = _gp->train(_hyps);
+    }
+    else if(not trained)
+        _nlz = _gp->train(_hyps);
     _hyps = _gp->get_hyp();
     auto train_end          = chrono::high_resolution_clock::now();
     const double time_train = duration_cast<chrono::milliseconds>(train_end - train_start).count();
@@ -531,9 +1277,96 @@ void MACE::_train_GP()
     BOOST_LOG_TRIVIAL(info) << "Time for GP training: " << (time_train/1000.0) << " s";
 }
 
+MatrixXd MACE::_multi_start_hyp(size_t num_screen)
+{
+    // The screening of initial hyperparameters and the likelihood
+    // optimization are run as independent tasks for each of the `_hyp_starts`
+    // starts and each spec, on single-output copies of the GP, so the
+    // hyperparameters of each spec are selected independently. Start 0 begins
+    // from the current hyperparameters and the others from random
+    // perturbations of them, drawn from `_engine` before the tasks are
+    // submitted, so that the result does not depend on the scheduling of
+    // threads
+    const size_t num_starts = std::max<size_t>(1, _hyp_starts);
+    const size_t screen_per_start = std::max<size_t>(1, num_screen / num_starts);
+    vector<MatrixXd> starts(num_starts, _hyps);
+    normal_distribution<double> perturb(0, 1);
+    for(size_t k = 1; k < num_starts; ++k)
+        for(long i = 0; i < starts[k].size(); ++i)
+            starts[k](i) += perturb(_engine);
+
+    // screening, the nlz of each screened start is evaluated with fixed
+    // hyperparameters, i.e., one factorization
+    MatrixXd screen_nlz = MatrixXd::Constant(num_starts, _num_spec, INF);
+    parallel_for(num_starts * _num_spec, [&](size_t task) {
+        const size_t k = task / _num_spec;
+        const size_t s = task % _num_spec;
+        GP* gp         = _new_spec_gp(s);
+        const MatrixXd hyp = gp->select_init_hyp(screen_per_start, starts[k].col(s));
+        gp->set_fixed(true);
+        const MatrixXd nlz = gp->train(hyp);
+        starts[k].col(s)   = hyp;
+        screen_nlz(k, s)   = nlz.allFinite() ? nlz.sum() : INF;
+        delete gp;
+    });
+
+    // hopeless starts are not optimized
+    const RowVectorXd best_screen = screen_nlz.colwise().minCoeff();
+    MatrixXd train_nlz = MatrixXd::Constant(num_starts, _num_spec, INF);
+    vector<MatrixXd> trained(starts);
+    parallel_for(num_starts * _num_spec, [&](size_t task) {
+        const size_t k = task / _num_spec;
+        const size_t s = task % _num_spec;
+        if(not (screen_nlz(k, s) <= best_screen(s) + _hyp_prune_nlz))
+            return;
+        GP* gp = _new_spec_gp(s);
+        gp->set_fixed(false);
+        const MatrixXd nlz = gp->train(starts[k].col(s));
+        train_nlz(k, s)    = nlz.allFinite() ? nlz.sum() : INF;
+        trained[k].col(s)  = gp->get_hyp();
+        delete gp;
+    });
+
+    // for each spec, the first start with the smallest nlz wins, ties are
+    // resolved by index
+    MatrixXd best_hyps = _hyps;
+    vector<size_t> best_ks(_num_spec, 0);
+    for(size_t s = 0; s < _num_spec; ++s)
+    {
+        for(size_t k = 1; k < num_starts; ++k)
+            if(train_nlz(k, s) < train_nlz(best_ks[s], s))
+                best_ks[s] = k;
+        best_hyps.col(s) = trained[best_ks[s]].col(s);
+    }
+    for(size_t s = 0; s < _num_spec; ++s)
+        BOOST_LOG_TRIVIAL(info) << "Multi-start hyp of spec " << s << ", screened nlz: " << screen_nlz.col(s).transpose()
+                                << ", trained nlz: " << train_nlz.col(s).transpose() << ", selected start " << best_ks[s];
+    return best_hyps;
+}
+MatrixXd MACE::_train_per_spec(const MatrixXd& hyps)
+{
+    // the specs are trained in parallel on single-output copies of the GP
+    MatrixXd trained = hyps;
+    parallel_for(_num_spec, [&](size_t s) {
+        GP* gp = _new_spec_gp(s);
+        gp->set_fixed(false);
+        gp->train(hyps.col(s));
+        trained.col(s) = gp->get_hyp();
+        delete gp;
+    });
+    return trained;
+}
+GP* MACE::_new_spec_gp(size_t spec_idx) const
+{
+    GP* gp = new GP(_gp->train_in(), _gp->train_out().col(spec_idx));
+    gp->set_noise_free(_noise_free);
+    if(not _noise_free)
+        gp->set_noise_lower_bound(_noise_lvl);
+    return gp;
+}
 vector<size_t> MACE::_pick_from_seq(size_t n, size_t m)
 {
-    MYASSERT(m <= n);
+    MACE_CHECK(m <= n);
     set<size_t> picked_set;
     uniform_int_distribution<size_t> i_distr(0, n - 1);
     while(picked_set.size() < m)
@@ -544,55 +1377,54 @@ vector<size_t> MACE::_pick_from_seq(size_t n, size_t m)
 }
 double MACE::_pf(const VectorXd& xs) const
 {
-    MYASSERT(_gp->trained());
-    if(_num_spec == 1)
-        return 1.0;
-    MatrixXd gpy, gps2;
-    _gp->predict(xs, gpy, gps2);
-    MatrixXd normed = -1 * gpy.cwiseQuotient(gps2.cwiseSqrt());
-    double prob = 1.0;
-    for(long i = 1; i < gpy.cols(); ++i)
-        prob *= normcdf(normed(i));
-    return prob;
+    return exp(_log_pf(xs));
 }
 double MACE::_pf(const VectorXd& xs, VectorXd& grad) const
 {
-    MYASSERT(_gp->trained());
+    MACE_CHECK(_gp->trained());
     const double pf  = exp(_log_pf(xs, grad));
     grad            *= pf;
     return pf;
 }
 double MACE::_log_pf(const VectorXd& xs) const
 {
-    MYASSERT(_gp->trained());
+    MACE_CHECK(_gp->trained());
     if(_num_spec == 1)
         return 0.0;
-    MatrixXd gpy, gps2;
-    _gp->predict(xs, gpy, gps2);
-    MatrixXd normed = -1 * gpy.cwiseQuotient(gps2.cwiseSqrt());
-    double log_prob = 0.0;
-    for(long i = 1; i < gpy.cols(); ++i)
-        log_prob += logphi(normed(i));
-    return log_prob;
+    VectorXd y, s2;
+    _predict_specs(xs, y, s2);
+    return _log_pf_pred(y, s2);
 }
 double MACE::_log_pf(const VectorXd& xs, VectorXd& grad) const
 {
-    MYASSERT(_gp->trained());
+    MACE_CHECK(_gp->trained());
     if(_num_spec == 1)
     {
         grad = VectorXd::Zero(xs.size());
         return 0.0;
     }
+    VectorXd y, s2;
+    MatrixXd gy, gs2;
+    _predict_specs(xs, y, s2, gy, gs2);
+    return _log_pf_pred(y, s2, gy, gs2, grad);
+}
+double MACE::_log_pf_pred(const VectorXd& y, const VectorXd& s2) const
+{
     double log_prob = 0.0;
+    for(size_t i = 1; i < _num_spec; ++i)
+        log_prob += logphi(-1 * y(i) / sqrt(s2(i)));
+    return log_prob;
+}
+double MACE::_log_pf_pred(const VectorXd& y, const VectorXd& s2, const MatrixXd& gy, const MatrixXd& gs2, VectorXd& grad) const
+{
+    double log_prob = 0.0;
+    grad            = VectorXd::Zero(_dim);
     for(size_t i = 1; i < _num_spec; ++i)
     {
-        double y, s2, s;
-        VectorXd gy, gs2, gs;
-        _gp->predict_with_grad(i, xs, y, s2, gy, gs2);
-        s      = sqrt(s2);
-        gs     = 0.5 * gs2 / sqrt(s2);
-        double normed    = -1 * y / s;
-        VectorXd gnormed = -1 * (s * gy - y * gs) / s2;
+        const double   s       = sqrt(s2(i));
+        const VectorXd gs      = 0.5 * gs2.col(i) / s;
+        const double   normed  = -1 * y(i) / s;
+        const VectorXd gnormed = -1 * (s * gy.col(i) - y(i) * gs) / s2(i);
         double lp, dlp;
         logphi(normed, lp, dlp);
         log_prob += lp;
@@ -600,42 +1432,87 @@ double MACE::_log_pf(const VectorXd& xs, VectorXd& grad) const
     }
     return log_prob;
 }
+void MACE::_gp_predict(size_t spec_idx, const VectorXd& x, double& y, double& s2) const
+{
+    _prof.add(Profiler::Predict);
+    _gp->predict(spec_idx, x, y, s2);
+}
+void MACE::_gp_predict_with_grad(size_t spec_idx, const VectorXd& x, double& y, double& s2, VectorXd& gy, VectorXd& gs2) const
+{
+    _prof.add(Profiler::Predict);
+    _gp->predict_with_grad(spec_idx, x, y, s2, gy, gs2);
+}
+void MACE::_gp_predict(const MatrixXd& xs, MatrixXd& y, MatrixXd& s2) const
+{
+    _prof.add(Profiler::Predict, xs.cols());
+    _gp->predict(xs, y, s2);
+}
+void MACE::_predict_specs(const VectorXd& x, VectorXd& y, VectorXd& s2) const
+{
+    // one call of the matrix interface predicts all the specs
+    MatrixXd gpy, gps2;
+    _gp_predict(x, gpy, gps2);
+    y  = gpy.row(0).transpose();
+    s2 = gps2.row(0).transpose();
+}
+void MACE::_predict_specs(const VectorXd& x, VectorXd& y, VectorXd& s2, MatrixXd& gy, MatrixXd& gs2) const
+{
+    y.resize(_num_spec);
+    s2.resize(_num_spec);
+    gy.resize(_dim, _num_spec);
+    gs2.resize(_dim, _num_spec);
+    VectorXd gyi, gs2i;
+    for(size_t i = 0; i < _num_spec; ++i)
+    {
+        _gp_predict_with_grad(i, x, y(i), s2(i), gyi, gs2i);
+        gy.col(i)  = gyi;
+        gs2.col(i) = gs2i;
+    }
+}
 double MACE::_s2(const VectorXd& x)const
 {
-    MYASSERT(_gp->trained());
+    MACE_CHECK(_gp->trained());
     double  y, s2;
-    _gp->predict(0, x, y, s2);
+    _gp_predict(0, x, y, s2);
     return s2;
 }
 double MACE::_s2(const VectorXd& x, VectorXd& grad)const
 {
-    MYASSERT(_gp->trained());
+    MACE_CHECK(_gp->trained());
     double  y, s2;
     VectorXd gy, gs2;
-    _gp->predict_with_grad(0, x, y, s2, gy, gs2);
+    _gp_predict_with_grad(0, x, y, s2, gy, gs2);
     grad = gs2;
     return s2;
 }
 double MACE::_pi_transf(const VectorXd& x) const
 {
-    MYASSERT(_gp->trained());
+    MACE_CHECK(_gp->trained());
+    double  y, s2;
+    _gp_predict(0, x, y, s2);
+    return _pi_transf(y, s2);
+}
+double MACE::_pi_transf(const VectorXd& x, VectorXd& grad) const
+{
+    MACE_CHECK(_gp->trained());
     double  y, s2;
-    _gp->predict(0, x, y, s2);
+    VectorXd gy, gs2;
+    _gp_predict_with_grad(0, x, y, s2, gy, gs2);
+    return _pi_transf(y, s2, gy, gs2, grad);
+}
+double MACE::_pi_transf(double y, double s2) const
+{
     // XXX: What about INF/NaN?
     const double s   = sqrt(s2);
     const double tau = _get_tau(0);
     double normed    = (tau - y) / s;
     return normed;
 }
-double MACE::_pi_transf(const VectorXd& x, VectorXd& grad) const
+double MACE::_pi_transf(double y, double s2, const VectorXd& gy, const VectorXd& gs2, VectorXd& grad) const
 {
-    MYASSERT(_gp->trained());
     const double tau = _get_tau(0);
-    double  y, s2, s;
-    VectorXd gy, gs2, gs;
-    _gp->predict_with_grad(0, x, y, s2, gy, gs2);
-    s  = sqrt(s2);
-    gs = 0.5 * gs2 / sqrt(s2);
+    const double   s       = sqrt(s2);
+    const VectorXd gs      = 0.5 * gs2 / s;
     const double   normed  = (tau - y) / s;
     const VectorXd gnormed = -1 * (s * gy + (tau - y) * gs) / s2;
     grad = gnormed;
@@ -643,46 +1520,192 @@ double MACE::_pi_transf(const VectorXd& x, VectorXd& grad) const
 }
 double MACE::_acq(string name, const VectorXd& x) const
 {
+    MACE_CHECK(_gp->trained());
     if(_num_spec > 1)
     {
-        cerr << "Currently only for unconstrained optimization" << endl;
-        exit(EXIT_FAILURE);
+        VectorXd y, s2;
+        _predict_specs(x, y, s2);
+        return _constr_acq(name, y, s2);
+    }
+    double y, s2;
+    _gp_predict(0, x, y, s2);
+    return _acq(name, y, s2);
+}
+double MACE::_acq(string name, const VectorXd& x, VectorXd& grad) const
+{
+    MACE_CHECK(_gp->trained());
+    if(_num_spec > 1)
+    {
+        VectorXd y, s2;
+        MatrixXd gy, gs2;
+        _predict_specs(x, y, s2, gy, gs2);
+        return _constr_acq(name, y, s2, gy, gs2, grad);
+    }
+    double y, s2;
+    VectorXd gy, gs2;
+    _gp_predict_with_grad(0, x, y, s2, gy, gs2);
+    return _acq(name, y, s2, gy, gs2, grad);
+}
+double MACE::_constr_acq(string name, const VectorXd& y, const VectorXd& s2) const
+{
+    // With constraints, the acquisition functions are weighted by PF in log
+    // domain, PI is converted to log PI so that it can be added to log PF,
+    // s2 is used for exploration and left unweighted
+    if(name == "s2")
+        return s2(0);
+    double val = _acq(name, y(0), s2(0));
+    if(name == "pi_transf")
+        val = logphi(val);
+    return val + _log_pf_pred(y, s2);
+}
+double MACE::_constr_acq(string name, const VectorXd& y, const VectorXd& s2, const MatrixXd& gy, const MatrixXd& gs2, VectorXd& grad) const
+{
+    if(name == "s2")
+    {
+        grad = gs2.col(0);
+        return s2(0);
+    }
+    double val = _acq(name, y(0), s2(0), gy.col(0), gs2.col(0), grad);
+    if(name == "pi_transf")
+    {
+        double lp, dlp;
+        logphi(val, lp, dlp);
+        val   = lp;
+        grad *= dlp;
+    }
+    VectorXd glog_pf;
+    val  += _log_pf_pred(y, s2, gy, gs2, glog_pf);
+    grad += glog_pf;
+    return val;
+}
+ArrayXd MACE::_acq_batch(string name, const ArrayXd& y, const ArrayXd& s2, const ArrayXd& log_pf) const
+{
+    // Same as the scalar acquisition functions and `_constr_acq`, the
+    // branches are replaced by `select`, so both sides are evaluated
+    const double  tau = _get_tau(0);
+    const ArrayXd s   = s2.sqrt();
+    ArrayXd val;
+    if(name == "pi_transf")
+    {
+        val = (tau - y) / s;
+        if(_num_spec > 1)
+            val = logphi(val);
+    }
+    else if(name == "log_lcb_improv_transf")
+    {
+        const ArrayXd lcb_improve = tau - (y - _kappa * s);
+        val = (lcb_improve > 20).select(lcb_improve.log(),
+              (lcb_improve > -10).select((1 + lcb_improve.exp()).log().log(), lcb_improve - 0.5 * lcb_improve.exp()));
+    }
+    else if(name == "log_ei")
+    {
+        const ArrayXd normed = (tau - y) / s;
+        const ArrayXd tail   = s.log() - 0.5 * normed.square() - log(sqrt(2 * M_PI)) - (normed.square() - 1).log();
+        val = (normed > -6).select((s * (normed * normcdf(normed) + normpdf(normed))).log(), tail);
+    }
+    else if(name == "s2")
+        return s2;
+    else
+    {
+        _fatal("Unknown acquisition function: " + name);
     }
+    return _num_spec > 1 ? ArrayXd(val + log_pf) : val;
+}
+ArrayXd MACE::_log_pf_batch(const MatrixXd& y, const MatrixXd& s2) const
+{
+    ArrayXd log_prob = ArrayXd::Zero(y.rows());
+    for(size_t i = 1; i < _num_spec; ++i)
+        log_prob += logphi(ArrayXd(-1 * y.col(i).array() / s2.col(i).array().sqrt()));
+    return log_prob;
+}
+double MACE::_acq(string name, double y, double s2) const
+{
     if(name == "pi_transf")
-        return _pi_transf(x);
+        return _pi_transf(y, s2);
     else if(name == "log_lcb_improv_transf")
-        return _log_lcb_improv_transf(x);
+        return _log_lcb_improv_transf(y, s2);
     else if(name == "log_ei")
-        return _log_ei(x);
+        return _log_ei(y, s2);
     else if(name == "s2")
-        return _s2(x);
+        return s2;
     else
     {
-        BOOST_LOG_TRIVIAL(fatal) << "Unknown acquisition function: " << name;
-        exit(EXIT_FAILURE);
+        _fatal("Unknown acquisition function: " + name);
     }
 }
-double MACE::_acq(string name, const VectorXd& x, VectorXd& grad) const
+double MACE::_acq(string name, double y, double s2, const VectorXd& gy, const VectorXd& gs2, VectorXd& grad) const
 {
     if(name == "pi_transf")
-        return _pi_transf(x, grad);
+        return _pi_transf(y, s2, gy, gs2, grad);
     else if(name == "log_lcb_improv_transf")
-        return _lcb_improv_transf(x, grad);
+        return _log_lcb_improv_transf(y, s2, gy, gs2, grad);
     else if(name == "log_ei")
-        return _log_ei(x, grad);
+        return _log_ei(y, s2, gy, gs2, grad);
     else if(name == "s2")
-        return _s2(x, grad);
+    {
+        grad = gs2;
+        return s2;
+    }
     else
     {
-        BOOST_LOG_TRIVIAL(fatal) << "Unknown acquisition function: " << name;
-        exit(EXIT_FAILURE);
+        _fatal("Unknown acquisition function: " + name);
     }
 }
+VectorXd MACE::_acq_pool_vals(const VectorXd& x) const
+{
+    // All the acquisition functions in `_acq_pool` are derived from one GP
+    // prediction, with constraints, the predictions of all specs are fused
+    // into one call. A single point is scored by the scalar functions, the
+    // vectorized ones only pay off for the batched version
+    MACE_CHECK(_gp->trained());
+    VectorXd vals(_acq_pool.size());
+    if(_num_spec > 1)
+    {
+        VectorXd y, s2;
+        _predict_specs(x, y, s2);
+        for(size_t i = 0; i < _acq_pool.size(); ++i)
+            vals(i) = _constr_acq(_acq_pool[i], y, s2);
+        return vals;
+    }
+    double y, s2;
+    _gp_predict(0, x, y, s2);
+    for(size_t i = 0; i < _acq_pool.size(); ++i)
+        vals(i) = _acq(_acq_pool[i], y, s2);
+    return vals;
+}
+MatrixXd MACE::_acq_pool_vals(const MatrixXd& xs) const
+{
+    // Batched version of `_acq_pool_vals`, the population is split into
+    // blocks scored in parallel, column i of the returned matrix are the
+    // acquisition values of xs.col(i)
+    MACE_CHECK(_gp->trained());
+    const long block_size = 64;
+    const long num_blocks = (xs.cols() + block_size - 1) / block_size;
+    MatrixXd vals(_acq_pool.size(), xs.cols());
+    parallel_for(num_blocks, [&](size_t b) {
+        const long start = b * block_size;
+        const long len   = std::min(block_size, xs.cols() - start);
+        vals.middleCols(start, len) = _acq_pool_block(xs.middleCols(start, len));
+    });
+    return vals;
+}
+MatrixXd MACE::_acq_pool_block(const MatrixXd& xs) const
+{
+    // one call of the matrix interface of GP for all the specs, transformed
+    // by the vectorized acquisition functions
+    MatrixXd y, s2;
+    _gp_predict(xs, y, s2);
+    const ArrayXd log_pf = _num_spec > 1 ? _log_pf_batch(y, s2) : ArrayXd::Zero(xs.cols());
+    MatrixXd vals(_acq_pool.size(), xs.cols());
+    for(size_t i = 0; i < _acq_pool.size(); ++i)
+        vals.row(i) = _acq_batch(_acq_pool[i], y.col(0), s2.col(0), log_pf).transpose().matrix();
+    return vals;
+}
 double MACE::_ei(const VectorXd& x) const
 {
-    MYASSERT(_gp->trained());
+    MACE_CHECK(_gp->trained());
     double  y, s2;
-    _gp->predict(0, x, y, s2);
+    _gp_predict(0, x, y, s2);
     const double s      = sqrt(s2);
     const double tau    = _get_tau(0);
     const double normed = (tau - y) / sqrt(s2);
@@ -691,11 +1714,11 @@ double MACE::_ei(const VectorXd& x) const
 
 double MACE::_ei(const VectorXd& x, VectorXd& grad) const
 {
-    MYASSERT(_gp->trained());
+    MACE_CHECK(_gp->trained());
     const double tau = _get_tau(0);
     double  y, s2, s;
     VectorXd gy, gs2, gs;
-    _gp->predict_with_grad(0, x, y, s2, gy, gs2);
+    _gp_predict_with_grad(0, x, y, s2, gy, gs2);
     s  = sqrt(s2);
     gs = 0.5 * gs2 / sqrt(s2);
     const double   normed    = (tau - y) / sqrt(s2);
@@ -709,7 +1732,18 @@ double MACE::_ei(const VectorXd& x, VectorXd& grad) const
 double MACE::_log_ei(const VectorXd& x) const
 {
     double y, s2;
-    _gp->predict(0, x, y, s2);
+    _gp_predict(0, x, y, s2);
+    return _log_ei(y, s2);
+}
+double MACE::_log_ei(const VectorXd& x, VectorXd& grad) const
+{
+    double y, s2;
+    VectorXd gy, gs2;
+    _gp_predict_with_grad(0, x, y, s2, gy, gs2);
+    return _log_ei(y, s2, gy, gs2, grad);
+}
+double MACE::_log_ei(double y, double s2) const
+{
     const double s      = sqrt(s2);
     const double tau    = _get_tau(0);
     const double normed = (tau - y) / sqrt(s2);
@@ -717,17 +1751,13 @@ double MACE::_log_ei(const VectorXd& x) const
                        : log(s) - 0.5 * pow(normed, 2) - log(sqrt(2 * M_PI)) - log(pow(normed, 2) - 1);
     // \lim_{z \to -\infty} \log\big(z\Phi(z) + \phi(z)\big) = \log \phi(z) - \log(z^2 - 1) 
 }
-
-double MACE::_log_ei(const VectorXd& x, VectorXd& grad) const
+double MACE::_log_ei(double y, double s2, const VectorXd& gy, const VectorXd& gs2, VectorXd& grad) const
 {
     const double tau = _get_tau(0);
-    double y, s2, s;
-    VectorXd gy, gs2, gs;
-    _gp->predict_with_grad(0, x, y, s2, gy, gs2);
-    s  = sqrt(s2);
-    gs = 0.5 * gs2 / sqrt(s2);
-    const double normed = (tau - y) / sqrt(s2);
-    const VectorXd gnormed   = -1 * (s * gy + (tau - y) * gs) / s2;
+    const double   s       = sqrt(s2);
+    const VectorXd gs      = 0.5 * gs2 / s;
+    const double   normed  = (tau - y) / sqrt(s2);
+    const VectorXd gnormed = -1 * (s * gy + (tau - y) * gs) / s2;
     double log_ei;
     if(normed > -6)
     {
@@ -746,38 +1776,72 @@ double MACE::_log_ei(const VectorXd& x, VectorXd& grad) const
 }
 double MACE::_lcb_improv(const VectorXd& x) const 
 {
-    const double tau   = _get_tau(0);
     double y, s2;
-    _gp->predict(0, x, y, s2);
+    _gp_predict(0, x, y, s2);
+    return _lcb_improv(y, s2);
+}
+double MACE::_lcb_improv(const VectorXd& x, VectorXd& grad) const 
+{
+    double y, s2;
+    VectorXd gy, gs2;
+    _gp_predict_with_grad(0, x, y, s2, gy, gs2);
+    return _lcb_improv(y, s2, gy, gs2, grad);
+}
+double MACE::_lcb_improv(double y, double s2) const 
+{
+    const double tau = _get_tau(0);
     const double lcb = y - _kappa * sqrt(s2);
     return tau - lcb;
 }
-double MACE::_lcb_improv(const VectorXd& x, VectorXd& grad) const 
+double MACE::_lcb_improv(double y, double s2, const VectorXd& gy, const VectorXd& gs2, VectorXd& grad) const 
 {
-    const double tau   = _get_tau(0);
-    double y, s2, lcb;
-    VectorXd gy, gs2, gs;
-    _gp->predict_with_grad(0, x, y, s2, gy, gs2);
-    gs   = 0.5 * gs2 / sqrt(s2);
-    lcb  = y - _kappa * sqrt(s2);
+    const double   tau = _get_tau(0);
+    const VectorXd gs  = 0.5 * gs2 / sqrt(s2);
+    const double   lcb = y - _kappa * sqrt(s2);
     grad = -1 * (gy - _kappa * gs);
     return tau - lcb;
 }
 double MACE::_lcb_improv_transf(const VectorXd& x) const
 {
-    const double lcb_improve = _lcb_improv(x);
-    return lcb_improve > 20 ? lcb_improve : log(1+exp(lcb_improve));
+    double y, s2;
+    _gp_predict(0, x, y, s2);
+    return _lcb_improv_transf(y, s2);
 }
 double MACE::_lcb_improv_transf(const VectorXd& x, VectorXd& grad) const
 {
-    const double lcb_improve  = _lcb_improv(x, grad);
+    double y, s2;
+    VectorXd gy, gs2;
+    _gp_predict_with_grad(0, x, y, s2, gy, gs2);
+    return _lcb_improv_transf(y, s2, gy, gs2, grad);
+}
+double MACE::_lcb_improv_transf(double y, double s2) const
+{
+    const double lcb_improve = _lcb_improv(y, s2);
+    return lcb_improve > 20 ? lcb_improve : log(1+exp(lcb_improve));
+}
+double MACE::_lcb_improv_transf(double y, double s2, const VectorXd& gy, const VectorXd& gs2, VectorXd& grad) const
+{
+    const double lcb_improve  = _lcb_improv(y, s2, gy, gs2, grad);
     const double val          = lcb_improve > 20 ? lcb_improve : log(1+exp(lcb_improve));
     grad                     *= lcb_improve > 20 ? 1.0 : exp(val) / (1 + exp(val));
     return val;
 }
 double MACE::_log_lcb_improv_transf(const VectorXd& x) const
 {
-    const double lcb_improve = _lcb_improv(x);
+    double y, s2;
+    _gp_predict(0, x, y, s2);
+    return _log_lcb_improv_transf(y, s2);
+}
+double MACE::_log_lcb_improv_transf(const VectorXd& x, VectorXd& grad) const
+{
+    double y, s2;
+    VectorXd gy, gs2;
+    _gp_predict_with_grad(0, x, y, s2, gy, gs2);
+    return _log_lcb_improv_transf(y, s2, gy, gs2, grad);
+}
+double MACE::_log_lcb_improv_transf(double y, double s2) const
+{
+    const double lcb_improve = _lcb_improv(y, s2);
     if(lcb_improve > 20)
     {
         return log(lcb_improve);
@@ -791,9 +1855,9 @@ double MACE::_log_lcb_improv_transf(const VectorXd& x) const
         return lcb_improve - 0.5 * exp(lcb_improve);
     }
 }
-double MACE::_log_lcb_improv_transf(const VectorXd& x, VectorXd& grad) const
+double MACE::_log_lcb_improv_transf(double y, double s2, const VectorXd& gy, const VectorXd& gs2, VectorXd& grad) const
 {
-    const double lcb_improve = _lcb_improv(x, grad);
+    const double lcb_improve = _lcb_improv(y, s2, gy, gs2, grad);
     double val;
     if(lcb_improve > 20)
     {
@@ -812,81 +1876,107 @@ double MACE::_log_lcb_improv_transf(const VectorXd& x, VectorXd& grad) const
     }
     return val;
 }
-VectorXd MACE::_msp(NLopt_wrapper::func f, const MatrixXd& sp, nlopt::algorithm algo, size_t max_eval)
+template<class F>
+VectorXd MACE::_msp(const F& f, const MatrixXd& sp, nlopt::algorithm algo, size_t max_eval)
 {
     double best_y   = INF;
     VectorXd best_x = sp.col(0);
-#pragma omp parallel for
-    for (long i = 0; i < sp.cols(); ++i)
-    {
-        NLopt_wrapper opt(algo, _dim, _scaled_lb, _scaled_ub);
-        opt.set_maxeval(max_eval);
-        opt.set_ftol_rel(1e-6);
-        opt.set_xtol_rel(1e-6);
-        opt.set_min_objective(f);
+    mutex best_mtx;
+    auto run_start  = [&](size_t i) -> void {
+        _prof.add(Profiler::MSPStart);
+        NLopt_lease opt = NLopt_wrapper::lease(algo, _dim, _scaled_lb, _scaled_ub);
+        opt->set_maxeval(max_eval);
+        opt->set_ftol_rel(1e-6);
+        opt->set_xtol_rel(1e-6);
+        opt->set_min_objective(f);
         VectorXd x = sp.col(i);
         double y   = INF;
         try
         {
-            opt.optimize(x, y);
+            opt->optimize(x, y);
         }
         catch (runtime_error& e)  // this kind of exception can usually be ignored
         {
             if(algo != nlopt::LN_SBPLX)
             {
-                VectorXd fg;
+                VectorXd fg(_dim);
+                NLopt_wrapper::Grad fgm(fg.data(), _dim);
                 x = _msp(f, x, nlopt::LN_SBPLX, max_eval * 3);
-                y = f(x, fg);
+                y = f(NLopt_wrapper::Point(x.data(), _dim), fgm);
             }
         }
         catch (exception& e)
         {
-            BOOST_LOG_TRIVIAL(fatal) << "Nlopt exception: " << e.what() << " for sp: " << sp.col(i).transpose()
-                                     << ", y = " << y;
-            exit(EXIT_FAILURE);
+            stringstream msg;
+            msg << "Nlopt exception: " << e.what() << " for sp: " << sp.col(i).transpose() << ", y = " << y;
+            _fatal(msg.str());
         }
-#pragma omp critical
+        _prof.add(Profiler::NLoptEval, opt->num_evals());
+        lock_guard<mutex> lk(best_mtx);
+        if (y < best_y)
         {
-            if (y < best_y)
-            {
-                best_x = x;
-                best_y = y;
-            }
+            best_x = x;
+            best_y = y;
         }
-    }
+    };
+    // the restart from the `catch` block submits to the same pool, the
+    // waiting thread runs the tasks so no thread is spawned
+    parallel_for(sp.cols(), run_start);
     return best_x;
 }
 MatrixXd MACE::_set_anchor()
 {
+    Profiler::Scope scope(_prof, Profiler::Anchor);
     const size_t num_rand_samp = 3;
     MatrixXd sp(_dim, 2 + num_rand_samp);
     sp << _unscale(_best_x), _best_posterior_x, _set_random(num_rand_samp);
-    MatrixXd random_fluctuation(sp.rows(), sp.cols());
-    random_fluctuation.setRandom();
-    random_fluctuation *= 1e-3 * (_scaled_ub - _scaled_lb);
-    sp += random_fluctuation;
+    uniform_real_distribution<double> fluctuation(-1e-3 * (_scaled_ub - _scaled_lb), 1e-3 * (_scaled_ub - _scaled_lb));
+    for(long i = 0; i < sp.cols(); ++i)
+        for(long j = 0; j < sp.rows(); ++j)
+            sp(j, i) += fluctuation(_engine);
     sp = sp.cwiseMin(_scaled_ub).cwiseMax(_scaled_lb);
-    MatrixXd heuristic_anchors(_dim, _acq_pool.size());
+    const size_t num_acq = _acq_pool.size();
+    MatrixXd msp_guess(_dim, num_acq);
+    MatrixXd heuristic_anchors(_dim, num_acq);
     const VectorXd lb = VectorXd::Constant(_dim, 1, _scaled_lb);
     const VectorXd ub = VectorXd::Constant(_dim, 1, _scaled_ub);
-    for(size_t i = 0; i < _acq_pool.size(); ++i)
-    {
-        NLopt_wrapper::func f = [&](const VectorXd& x, VectorXd& grad)->double{
-            double val =  -1*_acq(_acq_pool[i], x, grad);
-            grad *= -1;
+    auto nlopt_obj = [this](size_t i) {
+        return [this, i](const NLopt_wrapper::Point& x, NLopt_wrapper::Grad& grad)->double{
+            VectorXd g;
+            double val =  -1*_acq(_acq_pool[i], x, g);
+            grad = -1 * g;
             return val;
         };
+    };
+
+    // The anchors are searched as a task graph:
+    //   A_i: multi-start LBFGS from `sp` for the i-th acquisition function
+    //   B_i: MVMO seeded by A_i and the anchors B_0, ..., B_{i-1}, refined by LBFGS
+    // All A_i are independent and submitted at once, the chain of B_i runs in
+    // the calling thread, waiting for A_i before B_i, so that the A_i overlap
+    // with each other and with the B chain
+    unique_ptr<TaskGroup[]> stage_a(new TaskGroup[num_acq]);
+    for(size_t i = 0; i < num_acq; ++i)
+    {
+        stage_a[i].run([&, i]() {
+            msp_guess.col(i) = _msp(nlopt_obj(i), sp, nlopt::LD_LBFGS, 40);
+        });
+    }
+    for(size_t i = 0; i < num_acq; ++i)
+    {
         MVMO::MVMO_Obj mvmvo_f = [&](const VectorXd& x)->double{
+            _prof.add(Profiler::MVMOEval);
             return -1*_acq(_acq_pool[i], x);
         };
+        stage_a[i].wait();
         MatrixXd mvmo_guess(_dim, i + 1);
-        mvmo_guess.col(0)       = _msp(f, sp, nlopt::LD_LBFGS, 40);
+        mvmo_guess.col(0)       = msp_guess.col(i);
         mvmo_guess.rightCols(i) = heuristic_anchors.leftCols(i);
         MVMO mvmo_opt(mvmvo_f, lb, ub);
         mvmo_opt.set_max_eval(_dim * 50);
         mvmo_opt.set_archive_size(25);
         mvmo_opt.optimize(mvmo_guess);
-        heuristic_anchors.col(i) = _msp(f, mvmo_opt.best_x(), nlopt::LD_LBFGS, 40);
+        heuristic_anchors.col(i) = _msp(nlopt_obj(i), mvmo_opt.best_x(), nlopt::LD_LBFGS, 40);
     }
     // for(size_t i = 0; i <= num_weight; ++i)
     // {
@@ -918,22 +2008,23 @@ MatrixXd MACE::_set_anchor()
     // }
     return heuristic_anchors;
 }
-MatrixXd MACE::_select_candidate(const MatrixXd& ps, const MatrixXd& pf)
+MatrixXd MACE::_select_candidate(const MatrixXd& ps, const MatrixXd& pf, size_t num)
 {
+    Profiler::Scope scope(_prof, Profiler::Select);
     switch(_ss)
     {
         case Random:
-            return _select_candidate_random(ps, pf);
+            return _select_candidate_random(ps, pf, num);
         case Greedy:
-            return _select_candidate_greedy(ps, pf);
+            return _select_candidate_greedy(ps, pf, num);
         case Extreme:
-            return _select_candidate_extreme(ps, pf);
+            return _select_candidate_extreme(ps, pf, num);
     }
 }
-MatrixXd MACE::_select_candidate_extreme(const MatrixXd& ps, const MatrixXd& pf)
+MatrixXd MACE::_select_candidate_extreme(const MatrixXd& ps, const MatrixXd& pf, size_t num)
 {
-    MatrixXd candidates = _select_candidate_random(ps, pf);
-    const size_t num_extreme = std::min(_acq_pool.size(), std::min(_batch_size, (size_t)(ps.cols())));
+    MatrixXd candidates = _select_candidate_random(ps, pf, num);
+    const size_t num_extreme = std::min(_acq_pool.size(), std::min(num, (size_t)(ps.cols())));
     for(size_t i = 0; i < num_extreme; ++i)
     {
         size_t best_idx;
@@ -942,36 +2033,33 @@ MatrixXd MACE::_select_candidate_extreme(const MatrixXd& ps, const MatrixXd& pf)
     }
     return candidates;
 }
-MatrixXd MACE::_select_candidate_random(const MatrixXd& ps, const MatrixXd&)
+MatrixXd MACE::_select_candidate_random(const MatrixXd& ps, const MatrixXd&, size_t num)
 {
-    vector<size_t> eval_idxs = _pick_from_seq(ps.cols(), (size_t)ps.cols() > _batch_size ? _batch_size : ps.cols());
-    size_t num_rand = _batch_size > eval_idxs.size() ? _batch_size - eval_idxs.size() : 0;
-    MatrixXd candidates(_dim, _batch_size);
+    vector<size_t> eval_idxs = _pick_from_seq(ps.cols(), (size_t)ps.cols() > num ? num : ps.cols());
+    size_t num_rand = num > eval_idxs.size() ? num - eval_idxs.size() : 0;
+    MatrixXd candidates(_dim, num);
     candidates << _slice_matrix(ps, eval_idxs), _set_random(num_rand);
     if(num_rand > 0)
         BOOST_LOG_TRIVIAL(trace) << "NumRand: " << num_rand;
     return candidates;
 }
-MatrixXd MACE::_select_candidate_greedy(const MatrixXd& ps, const MatrixXd&)
+MatrixXd MACE::_select_candidate_greedy(const MatrixXd& ps, const MatrixXd&, size_t num)
 {
-    const size_t batch_selection = (size_t)ps.cols() < _batch_size ? ps.cols() : _batch_size;
-    const MatrixXd& dbx          = _gp->train_in();
+    // Greedy max-min selection, the distance of each point in ps to the
+    // evaluated and the pending points is computed once, and then only updated with the
+    // newly selected point
+    const size_t batch_selection = (size_t)ps.cols() < num ? ps.cols() : num;
     vector<size_t> selected_idx;
+    VectorXd dists = min_sq_dist(_dbx, ps).cwiseMin(min_sq_dist(_pending_x, ps));
     for(size_t i = 0; i < batch_selection; ++i)
     {
-        MatrixXd ref(_dim, dbx.cols() + selected_idx.size());
-        ref.leftCols(dbx.cols()) = dbx;
-        if(not selected_idx.empty())
-            ref.rightCols(selected_idx.size()) = _slice_matrix(ps, selected_idx);
-        VectorXd dists(ps.cols());
         long max_idx = 0;
-        for(long j  = 0; j < ps.cols(); ++j)
-            dists[j] = (ref.colwise() - ps.col(j)).colwise().norm().minCoeff();
         dists.maxCoeff(&max_idx);
         selected_idx.push_back(max_idx);
+        dists = dists.cwiseMin((ps.colwise() - ps.col(max_idx)).colwise().squaredNorm().transpose());
     }
-    size_t num_rand = _batch_size  - selected_idx.size();
-    MatrixXd candidates(_dim, _batch_size);
+    size_t num_rand = num  - selected_idx.size();
+    MatrixXd candidates(_dim, num);
     candidates << _slice_matrix(ps, selected_idx), _set_random(num_rand);
     if(num_rand > 0)
         BOOST_LOG_TRIVIAL(trace) << "NumRand: " << num_rand;
@@ -990,17 +2078,18 @@ void MACE::_set_kappa()
 }
 double MACE::_get_tau(size_t spec_idx) const
 {
-    // XXX: Only for unconstrained problems
-    if(_posterior_ref)
+    // the posterior minimum is only a reference when it is predicted
+    // feasible
+    if(_posterior_ref and _is_feas(_best_posterior_y))
         return _best_posterior_y(spec_idx) - std::max(0.0, _EI_jitter);
     else
         return _best_y(spec_idx) - std::max(0.0, _EI_jitter);
 }
 bool  MACE::_duplication_checking(const VectorXd& x) const 
 {
-    return _duplication_checking(x, _gp->train_in());
+    return _dbx_index.has_neighbor(x, _eps * (_scaled_ub - _scaled_lb));
 }
-bool  MACE::_duplication_checking(const VectorXd& x, const MatrixXd& ref) const
+bool  MACE::_duplication_checking(const VectorXd& x, const Ref<const MatrixXd>& ref) const
 {
     for(long i = 0; i < ref.cols(); ++i)
     {
@@ -1011,14 +2100,17 @@ bool  MACE::_duplication_checking(const VectorXd& x, const MatrixXd& ref) const
 }
 MatrixXd MACE::_adjust_x(const MatrixXd& x)
 {
-    assert((size_t)x.rows() == _dim);
-    assert(x.cols() >  0);
+    // The evaluated points are checked with `_dbx_index`, only the pending
+    // points and the rest of the batch are scanned
+    MACE_CHECK((size_t)x.rows() == _dim);
+    MACE_CHECK(x.cols() >  0);
+    Profiler::Scope scope(_prof, Profiler::Adjust);
     MatrixXd adjusted = x;
     for(long i = 0; i < adjusted.cols(); ++i)
     {
-        MatrixXd ref(_dim, _gp->train_in().cols() + x.cols() - i - 1);
-        ref << _gp->train_in(), x.rightCols(x.cols() - i - 1);
-        while(_duplication_checking(adjusted.col(i), ref))
+        while(_duplication_checking(adjusted.col(i))
+              or _duplication_checking(adjusted.col(i), _pending_x)
+              or _duplication_checking(adjusted.col(i), x.rightCols(x.cols() - i - 1)))
             adjusted.col(i) = _set_random(1);
         if(adjusted.col(i) != x.col(i))
             BOOST_LOG_TRIVIAL(trace) << "Random sampling to avoid duplication evaluation for eval_x " << i;
@@ -1027,21 +2119,49 @@ MatrixXd MACE::_adjust_x(const MatrixXd& x)
 }
 void MACE::_set_best_posterior_mean()
 {
-    //XXX: If MACE is expanded to constrained problems, this function shoule be reimplemented!
-    assert(_gp != nullptr and _gp->trained());
+    // With constraints, the posterior mean of the objective is minimized over
+    // the points whose posterior means of the constraints are satisfied, as
+    // by `_better`, an infeasible point is ranked behind the evaluated ones by
+    // its predicted violation
+    MACE_CHECK(_gp != nullptr and _gp->trained());
+    Profiler::Scope scope(_prof, Profiler::PosteriorMean);
     VectorXd lb = VectorXd::Constant(_dim, 1, _scaled_lb);
     VectorXd ub = VectorXd::Constant(_dim, 1, _scaled_ub);
+    const double worst_y = _dby.row(0).maxCoeff();
     auto mvmo_obj = [&](const VectorXd& xs)->double{
-        double y, s2;
-        _gp->predict(0, xs, y, s2);
-        return y;
+        _prof.add(Profiler::MVMOEval);
+        if(_num_spec == 1)
+        {
+            double y, s2;
+            _gp_predict(0, xs, y, s2);
+            return y;
+        }
+        VectorXd y, s2;
+        _predict_specs(xs, y, s2);
+        return _is_feas(y) ? y(0) : std::max(y(0), worst_y) + _violation(y);
     };
-    auto msp_obj = [&](const VectorXd& xs, VectorXd& grad)->double{
-        double y, s2;
-        VectorXd gy, gs2;
-        _gp->predict_with_grad(0, xs, y, s2, gy, gs2);
-        grad = gy;
-        return y;
+    auto msp_obj = [&](const NLopt_wrapper::Point& xs, NLopt_wrapper::Grad& grad)->double{
+        if(_num_spec == 1)
+        {
+            double y, s2;
+            VectorXd gy, gs2;
+            _gp_predict_with_grad(0, xs, y, s2, gy, gs2);
+            grad = gy;
+            return y;
+        }
+        VectorXd y, s2;
+        MatrixXd gy, gs2;
+        _predict_specs(xs, y, s2, gy, gs2);
+        if(_is_feas(y))
+        {
+            grad = gy.col(0);
+            return y(0);
+        }
+        grad = y(0) > worst_y ? VectorXd(gy.col(0)) : VectorXd::Zero(_dim);
+        for(size_t i = 1; i < _num_spec; ++i)
+            if(y(i) > 0)
+                grad += gy.col(i);
+        return std::max(y(0), worst_y) + _violation(y);
     };
     MVMO mvmo_opt(mvmo_obj, lb, ub);
     mvmo_opt.set_max_eval(_dim * 50);
@@ -1050,6 +2170,6 @@ void MACE::_set_best_posterior_mean()
     _best_posterior_x = _msp(msp_obj, mvmo_opt.best_x(), nlopt::LD_LBFGS, 40);
     MatrixXd tmp_gpy;
     MatrixXd tmp_gps2;
-    _gp->predict(_best_posterior_x, tmp_gpy, tmp_gps2);
+    _gp_predict(_best_posterior_x, tmp_gpy, tmp_gps2);
     _best_posterior_y = tmp_gpy.row(0).transpose();
 }
@@ -4,13 +4,19 @@
 #include "GP.h"
 #include "MOO.h"
 #include "NLopt_wrapper.h"
+#include "KDTree.h"
+#include "Profiler.h"
+#include "Logging.h"
 #include <Eigen/Dense>
+#include <map>
+#include <memory>
 #include <random>
 #include <string>
 class MACE
 {
 public:
     typedef std::function<Eigen::VectorXd(const Eigen::VectorXd&)> Obj;
+    typedef std::function<Eigen::MatrixXd(const Eigen::MatrixXd&)> BatchObj; // one column for each point
     enum SelectStrategy
     {
         Random = 0,
@@ -19,10 +25,15 @@ public:
     };
     MACE(Obj f, size_t num_spec, const Eigen::VectorXd& lb, const Eigen::VectorXd& ub,
          std::string log_name = "mace.log");
+    MACE(size_t num_spec, const Eigen::VectorXd& lb, const Eigen::VectorXd& ub,
+         std::string log_name = "mace.log"); // without objective, only `ask` and `tell` are used
     ~MACE();
     void initialize(const Eigen::MatrixXd& dbx, const Eigen::MatrixXd& dby);
     void initialize(size_t);
     void initialize(std::string xfile, std::string yfile);
+    void initialize_binary(std::string db_file, size_t max_gp_size = 0); // at most max_gp_size points are used by GP, 0 for all
+    void resume(std::string checkpoint_file);             // restore the state from a checkpoint, instead of `initialize`
+    void save_checkpoint(std::string checkpoint_file) const;
 
     void set_init_num(size_t);
     void set_max_eval(size_t);
@@ -31,12 +42,23 @@ public:
     void set_eval_fixed(size_t);
     void set_seed(size_t);
     void set_gp_noise_lower_bound(double);
+    void set_hyp_starts(size_t);
+    void set_checkpoint(std::string path); // write a checkpoint to `path` after each iteration
+    void set_profile(std::string path);    // append the timing and counters of each iteration to `path` as JSON lines
+    void set_log_async(bool);              // queue the log records, written to the file by a background thread
+    void set_log_level(boost::log::trivial::severity_level);
+    void set_trace(std::string path);      // write the bulk numeric data to a binary trace instead of the text log
+    void set_log_study(std::string study); // only write the records tagged with `study` by `StudyTag`
+    void set_throw_on_error(bool);         // throw std::runtime_error on fatal errors instead of exiting, for hosts of many MACE objects
+    void set_sparse_gp(bool flag, size_t threshold, size_t num_inducing);
     void set_mo_record(bool);
     void set_mo_gen(size_t);
     void set_mo_np(size_t);
     void set_mo_f(double);
     void set_mo_cr(double);
     void set_batch(size_t);
+    void set_batch_func(BatchObj f); // evaluate each batch with one call of `f` instead of one call of `_func` per point
+    void set_speculation(double factor); // duplicate the stragglers of a batch running longer than `factor` times the median, 0 to disable
     void set_selection_strategy(SelectStrategy ss){_ss = ss;}
     void set_use_sobol(bool flag){_use_sobol = flag;}
     void set_noise_free(bool flag){_noise_free = flag;}
@@ -48,14 +70,26 @@ public:
 
     Eigen::VectorXd best_x() const;
     Eigen::VectorXd best_y() const;
+    size_t num_eval() const { return _eval_counter; }
+    const Profiler::Record& last_profile() const { return _prof.last(); } // timing and counters of the last iteration
 
     void optimize_one_step(); // one iteration of BO, so that BO could be used as a plugin of other application
     void optimize();          // bayesian optimization
+    void optimize_async();    // asynchronous bayesian optimization, a new point is proposed whenever an evaluation finishes
     void blcb();     // one iteration of BLCB
     Eigen::MatrixXd blcb_one_step();     // one iteration of BLCB
 
+    // Ask/tell interface, the points are evaluated by the caller instead of
+    // `_func`, one column for each point, in [lb, ub]. Points asked before
+    // enough points are told to create the GP are from the initial sampling,
+    // points asked but not told yet are fantasized by the GP, so that they
+    // are not proposed again
+    Eigen::MatrixXd ask(size_t num);
+    void tell(const Eigen::MatrixXd& xs, const Eigen::MatrixXd& ys); // throw std::invalid_argument on invalid data
+
 private:
     Obj _func;
+    BatchObj _batch_func;
 
 protected:
     const Eigen::VectorXd _lb;
@@ -77,6 +111,11 @@ protected:
     bool _posterior_ref        = false;
     size_t _tol_no_improvement = 10;
     size_t _eval_fixed         = 100;  // after _eval_fixed evaluations, only train GP when _tol_no_improvement is reached
+    size_t _hyp_starts         = 4;    // number of parallel starts when re-selecting GP hyperparameters
+    double _hyp_prune_nlz      = 20;   // starts whose screened nlz is worse than the best by this are not optimized
+    bool   _sparse_gp          = false;
+    size_t _sparse_threshold   = 1000; // in sparse mode, only _num_inducing points are used by GP when there are more evaluations than this
+    size_t _num_inducing       = 500;
     bool _mo_record            = false;
     size_t _mo_gen             = 250;
     size_t _mo_np              = 100;
@@ -86,6 +125,8 @@ protected:
     bool _noise_free           = false;
     bool _use_sobol            = false;  // use sobol for initial sampling
     SelectStrategy _ss         = SelectStrategy::Random;
+    std::string _checkpoint_file;
+    double _speculate          = 0;
     // bool _use_extreme          = true;  // when selecting points on PF, firstly select the point with extreme value, if batch =
     //                                     // 1, select the point with best EI, if batch = 2, select points with best EI and best
     //                                     // LCB
@@ -108,13 +149,43 @@ protected:
     Eigen::VectorXd _best_posterior_y; 
     Eigen::MatrixXd _eval_x;
     Eigen::MatrixXd _eval_y;
+    Eigen::MatrixXd _dbx; // all evaluated points, in [_scaled_lb, _scaled_ub]
+    Eigen::MatrixXd _dby;
+    std::vector<size_t> _gp_idx; // columns of `_dbx` used by the GP when it is built on a subset, empty otherwise
+    KDTree _dbx_index = KDTree(_dim); // index of `_dbx` for duplication checking
+    Eigen::MatrixXd _pending_x = Eigen::MatrixXd(_dim, 0); // points being evaluated in asynchronous mode
+    Eigen::MatrixXd _asked     = Eigen::MatrixXd(_dim, 0); // points returned by `ask` and not told yet
+    bool            _told      = true;                     // data is told since the last training of GP
     std::mt19937_64 _engine = std::mt19937_64(_seed);
     std::vector<std::string> _acq_pool{"log_lcb_improv_transf", "log_ei", "pi_transf"};
+    mutable Profiler _prof;
+    std::unique_ptr<LogSink>     _log_sink;
+    std::unique_ptr<TraceWriter> _trace;
+    bool                         _log_async = false;
+    std::string                  _log_study;
+    bool                         _throw_on_error = false;
+#ifdef MYDEBUG
+    boost::log::trivial::severity_level _log_level = boost::log::trivial::trace;
+#else
+    boost::log::trivial::severity_level _log_level = boost::log::trivial::info;
+#endif
 
     // inner functions
     Eigen::MatrixXd _set_random(size_t num); // random sampling in [_scaled_lb, _scaled_lbub]
     Eigen::MatrixXd _doe(size_t num); // design of experiments via sobol quasi-random
     void _train_GP();
+    void _save_checkpoint() const;
+    void _add_data(const Eigen::MatrixXd& xs, const Eigen::MatrixXd& ys);
+    bool _use_sparse() const;
+    void _rebuild_gp();
+    void _rebuild_gp(size_t max_size);
+    void _set_gp_data(const std::vector<size_t>& idxs); // recreate the GP on the columns `idxs` of _dbx
+    void _update_subset(size_t first, size_t num);
+    void _init_from_db(size_t max_gp_size);
+    std::vector<size_t> _select_subset(size_t m) const;
+    Eigen::MatrixXd _multi_start_hyp(size_t num_screen);
+    Eigen::MatrixXd _train_per_spec(const Eigen::MatrixXd& hyps); // optimize the hyperparameters of each spec in parallel
+    GP* _new_spec_gp(size_t spec_idx) const; // single-output GP of one spec, on the training data of `_gp`
 
     Eigen::MatrixXd _rescale(const Eigen::MatrixXd& xs) const noexcept; // scale x from [scaled_lb, scaled_ub] to [lb, ub]
     Eigen::MatrixXd _unscale(const Eigen::MatrixXd& xs) const noexcept; // scale x from [lb, ub] to [scaled_lb, scaled_ub]
@@ -123,7 +194,9 @@ protected:
     bool   _better(const Eigen::VectorXd& v1, const Eigen::VectorXd& v2) const;
     bool   _is_feas(const Eigen::VectorXd& v) const;
     
-    void _init_boost_log() const;
+    [[noreturn]] void _fatal(const std::string& msg) const; // log, then exit or throw
+    void _init_boost_log(bool append = false);
+    void _log_data(const std::string& tag, const Eigen::MatrixXd& data) const; // to the trace if any, otherwise to the text log
 
     size_t _find_best(const Eigen::MatrixXd& dby) const;
     std::vector<size_t> _seq_idx(size_t) const;
@@ -133,6 +206,21 @@ protected:
     void _print_log();
 
     Eigen::MatrixXd _run_func(const Eigen::MatrixXd&);
+    Eigen::VectorXd _run_one(const Eigen::VectorXd& scaled_x); // without logging or updating the best
+    Eigen::MatrixXd _run_speculative(const Eigen::MatrixXd& scaled_xs);
+    void _penalize_failures(Eigen::MatrixXd& ys) const; // results with INF|NAN values are failed evaluations
+    void _update_best(const Eigen::MatrixXd& scaled_xs, const Eigen::MatrixXd& ys);
+    Eigen::MatrixXd _propose(size_t num);
+    Eigen::MatrixXd _propose(size_t num, const Eigen::MatrixXd& pending_x); // with the pending points fantasized
+
+    // GP predictions counted by `_prof`
+    void _gp_predict(size_t spec_idx, const Eigen::VectorXd& x, double& y, double& s2) const;
+    void _gp_predict_with_grad(size_t spec_idx, const Eigen::VectorXd& x, double& y, double& s2, Eigen::VectorXd& gy, Eigen::VectorXd& gs2) const;
+    void _gp_predict(const Eigen::MatrixXd& xs, Eigen::MatrixXd& y, Eigen::MatrixXd& s2) const;
+
+    // predictions of all the specs at x, gy and gs2 are dim * num_spec
+    void _predict_specs(const Eigen::VectorXd& x, Eigen::VectorXd& y, Eigen::VectorXd& s2) const;
+    void _predict_specs(const Eigen::VectorXd& x, Eigen::VectorXd& y, Eigen::VectorXd& s2, Eigen::MatrixXd& gy, Eigen::MatrixXd& gs2) const;
 
     // acquisition functions
     double _pf(const Eigen::VectorXd&) const;
@@ -155,19 +243,45 @@ protected:
     double _s2(const Eigen::VectorXd&, Eigen::VectorXd& grad) const;
     double _acq(std::string name, const Eigen::VectorXd&) const;
     double _acq(std::string name, const Eigen::VectorXd&, Eigen::VectorXd& grad) const;
+    Eigen::VectorXd _acq_pool_vals(const Eigen::VectorXd&) const; // all acquisition functions in _acq_pool with one GP prediction
+    Eigen::MatrixXd _acq_pool_vals(const Eigen::MatrixXd&) const; // batched version, one column for each point
+    Eigen::MatrixXd _acq_pool_block(const Eigen::MatrixXd&) const; // batched version in the calling thread
+
+    // acquisition functions computed from the GP prediction (y, s2) and its gradient (gy, gs2)
+    double _log_ei(double y, double s2) const;
+    double _log_ei(double y, double s2, const Eigen::VectorXd& gy, const Eigen::VectorXd& gs2, Eigen::VectorXd& grad) const;
+    double _lcb_improv(double y, double s2) const;
+    double _lcb_improv(double y, double s2, const Eigen::VectorXd& gy, const Eigen::VectorXd& gs2, Eigen::VectorXd& grad) const;
+    double _lcb_improv_transf(double y, double s2) const;
+    double _lcb_improv_transf(double y, double s2, const Eigen::VectorXd& gy, const Eigen::VectorXd& gs2, Eigen::VectorXd& grad) const;
+    double _log_lcb_improv_transf(double y, double s2) const;
+    double _log_lcb_improv_transf(double y, double s2, const Eigen::VectorXd& gy, const Eigen::VectorXd& gs2, Eigen::VectorXd& grad) const;
+    double _pi_transf(double y, double s2) const;
+    double _pi_transf(double y, double s2, const Eigen::VectorXd& gy, const Eigen::VectorXd& gs2, Eigen::VectorXd& grad) const;
+    double _log_pf_pred(const Eigen::VectorXd& y, const Eigen::VectorXd& s2) const; // from the predictions of all specs
+    double _log_pf_pred(const Eigen::VectorXd& y, const Eigen::VectorXd& s2, const Eigen::MatrixXd& gy, const Eigen::MatrixXd& gs2, Eigen::VectorXd& grad) const;
+    double _constr_acq(std::string name, const Eigen::VectorXd& y, const Eigen::VectorXd& s2) const; // acquisition weighted by PF
+    double _constr_acq(std::string name, const Eigen::VectorXd& y, const Eigen::VectorXd& s2, const Eigen::MatrixXd& gy, const Eigen::MatrixXd& gs2, Eigen::VectorXd& grad) const;
+    // vectorized acquisition functions for arrays of predictions of the
+    // objective, `log_pf` is only used for constrained problems
+    Eigen::ArrayXd _acq_batch(std::string name, const Eigen::ArrayXd& y, const Eigen::ArrayXd& s2, const Eigen::ArrayXd& log_pf) const;
+    Eigen::ArrayXd _log_pf_batch(const Eigen::MatrixXd& y, const Eigen::MatrixXd& s2) const; // y, s2: num_points * num_spec
+    double _acq(std::string name, double y, double s2) const;
+    double _acq(std::string name, double y, double s2, const Eigen::VectorXd& gy, const Eigen::VectorXd& gs2, Eigen::VectorXd& grad) const;
 
     
-    Eigen::VectorXd _msp(NLopt_wrapper::func f, const Eigen::MatrixXd& sp, nlopt::algorithm=nlopt::LD_SLSQP, size_t max_eval = 100);
+    template<class F> // F: double(const NLopt_wrapper::Point&, NLopt_wrapper::Grad&)
+    Eigen::VectorXd _msp(const F& f, const Eigen::MatrixXd& sp, nlopt::algorithm=nlopt::LD_SLSQP, size_t max_eval = 100);
     Eigen::MatrixXd _set_anchor();
-    Eigen::MatrixXd _select_candidate(const Eigen::MatrixXd&, const Eigen::MatrixXd&);
-    Eigen::MatrixXd _select_candidate_random(const Eigen::MatrixXd&, const Eigen::MatrixXd&);
-    Eigen::MatrixXd _select_candidate_greedy(const Eigen::MatrixXd&, const Eigen::MatrixXd&);
-    Eigen::MatrixXd _select_candidate_extreme(const Eigen::MatrixXd&, const Eigen::MatrixXd&);
+    Eigen::MatrixXd _select_candidate(const Eigen::MatrixXd&, const Eigen::MatrixXd&, size_t num);
+    Eigen::MatrixXd _select_candidate_random(const Eigen::MatrixXd&, const Eigen::MatrixXd&, size_t num);
+    Eigen::MatrixXd _select_candidate_greedy(const Eigen::MatrixXd&, const Eigen::MatrixXd&, size_t num);
+    Eigen::MatrixXd _select_candidate_extreme(const Eigen::MatrixXd&, const Eigen::MatrixXd&, size_t num);
     double _get_tau(size_t spec_idx) const;
     void   _set_kappa();
     bool   _duplication_checking(const Eigen::VectorXd& x) const;
-    bool   _duplication_checking(const Eigen::VectorXd& x, const Eigen::MatrixXd& ref) const;
+    bool   _duplication_checking(const Eigen::VectorXd& x, const Eigen::Ref<const Eigen::MatrixXd>& ref) const;
     Eigen::MatrixXd _adjust_x(const Eigen::MatrixXd& x);
-    Eigen::MatrixXd _adaptive_sampling();
+    Eigen::MatrixXd _adaptive_sampling(size_t num);
     void _set_best_posterior_mean();
 };
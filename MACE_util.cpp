@@ -1,5 +1,8 @@
 #include "MACE_util.h"
 #include <iostream>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 using namespace std;
 
 void run_cmd(string cmd)
@@ -22,3 +25,63 @@ int run_cmd(vector<string> cmds)
     }
     return ret;
 }
+
+// Chebyshev coefficients of erfc(z), z >= 0, from Numerical Recipes (3rd
+// edition, section 6.2), erfc(z) = t * exp(-z^2 + erfc_exponent(z)) with
+// t = 2 / (2 + z)
+static const double erfc_cof[28] = {
+    -1.3026537197817094,   6.4196979235649026e-1, 1.9476473204185836e-2, -9.561514786808631e-3,
+    -9.46595344482036e-4,  3.66839497852761e-4,   4.2523324806907e-5,    -2.0278578112534e-5,
+    -1.624290004647e-6,    1.303655835580e-6,     1.5626441722e-8,       -8.5238095915e-8,
+    6.529054439e-9,        5.059343495e-9,        -9.91364156e-10,       -2.27365122e-10,
+    9.6467911e-11,         2.394038e-12,          -6.886027e-12,         8.94487e-13,
+    3.13092e-13,           -1.12708e-13,          3.81e-16,              7.106e-15,
+    -1.523e-15,            -9.4e-17,              1.21e-16,              -2.8e-17};
+
+// log(erfc(z)) for z >= 0, computed in log domain so that it does not
+// underflow for large z
+static Eigen::ArrayXd log_erfc_pos(const Eigen::ArrayXd& z)
+{
+    const Eigen::ArrayXd t  = 2.0 / (2.0 + z);
+    const Eigen::ArrayXd ty = 4.0 * t - 2.0;
+    Eigen::ArrayXd d        = Eigen::ArrayXd::Zero(z.size());
+    Eigen::ArrayXd dd       = Eigen::ArrayXd::Zero(z.size());
+    for(int j = 27; j > 0; --j)
+    {
+        const Eigen::ArrayXd tmp = d;
+        d  = ty * d - dd + erfc_cof[j];
+        dd = tmp;
+    }
+    return t.log() - z.square() + 0.5 * (erfc_cof[0] + ty * d) - dd;
+}
+Eigen::ArrayXd normcdf(const Eigen::ArrayXd& x)
+{
+    // normcdf(x) = 0.5 * erfc(-x / sqrt(2)), the tail is computed from |x|
+    const Eigen::ArrayXd tail = 0.5 * log_erfc_pos(x.abs() * M_SQRT1_2).exp();
+    return (x < 0).select(tail, 1.0 - tail);
+}
+Eigen::ArrayXd normpdf(const Eigen::ArrayXd& x)
+{
+    return (-0.5 * x.square()).exp() * (0.5 * M_2_SQRTPI * M_SQRT1_2);
+}
+Eigen::ArrayXd logphi(const Eigen::ArrayXd& x)
+{
+    const Eigen::ArrayXd log_tail = log_erfc_pos(x.abs() * M_SQRT1_2) - M_LN2;
+    return (x < 0).select(log_tail, (-log_tail.exp()).log1p());
+}
+Eigen::VectorXd min_sq_dist(const Eigen::MatrixXd& ref, const Eigen::MatrixXd& xs)
+{
+    const long block_size = 256;
+    const Eigen::RowVectorXd xs_sq = xs.colwise().squaredNorm();
+    Eigen::VectorXd min_dist = Eigen::VectorXd::Constant(xs.cols(), std::numeric_limits<double>::infinity());
+    for(long start = 0; start < ref.cols(); start += block_size)
+    {
+        const long len = std::min(block_size, ref.cols() - start);
+        const auto block = ref.middleCols(start, len);
+        Eigen::MatrixXd dist = -2 * block.transpose() * xs;
+        dist.colwise() += block.colwise().squaredNorm().transpose();
+        dist.rowwise() += xs_sq;
+        min_dist = min_dist.cwiseMin(dist.colwise().minCoeff().transpose());
+    }
+    return min_dist.cwiseMax(0);
+}
@@ -1,6 +1,22 @@
 #pragma once
 #include<string>
 #include<vector>
+#include<Eigen/Dense>
 
 void run_cmd(std::string);
 int  run_cmd(std::vector<std::string>);
+
+// Element-wise Gaussian functions on arrays, written with Eigen array
+// expressions and `select` instead of branches, so that they are vectorized
+// with the instruction set the code is compiled for (see the `MACE_NATIVE`
+// CMake option). Computed in log domain, their relative error grows with
+// x^2 in the tails: below 2e-13 for |x| <= 30 and 5e-13 up to |x| = 40,
+// against `erfc` of the C library (see test/test_mace_util.cpp)
+Eigen::ArrayXd normcdf(const Eigen::ArrayXd& x);
+Eigen::ArrayXd normpdf(const Eigen::ArrayXd& x);
+Eigen::ArrayXd logphi(const Eigen::ArrayXd& x); // log(normcdf(x)), also accurate for very negative x
+
+// Squared Euclidean distance from each column of xs to its nearest column of
+// ref, computed block by block as |r|^2 + |x|^2 - 2 r^T x with matrix products,
+// INF if ref is empty
+Eigen::VectorXd min_sq_dist(const Eigen::MatrixXd& ref, const Eigen::MatrixXd& xs);
@@ -1,23 +1,48 @@
 #include "NLopt_wrapper.h"
-#include "util.h"
 using namespace std;
 using namespace Eigen;
+
+// optimizers cached by each thread, at most `max_cached` of them are kept
+static const size_t max_cached = 16;
+static thread_local vector<unique_ptr<NLopt_wrapper>> cached_opts;
+
 NLopt_wrapper::NLopt_wrapper(nlopt::algorithm a, size_t d, double lb, double ub)
-    : _opt(nlopt::opt(a, d))
+    : _opt(nlopt::opt(a, d)), _algo(a), _dim(d), _lb(lb), _ub(ub), _g(d), _stlsp(d)
 {
     _opt.set_lower_bounds(lb);
     _opt.set_upper_bounds(ub);
 }
-void NLopt_wrapper::set_min_objective(NLopt_wrapper::func f)
+NLopt_lease NLopt_wrapper::lease(nlopt::algorithm a, size_t d, double lb, double ub)
 {
-    _f = f;
-    _opt.set_min_objective([](const vector<double>& x, vector<double>& grad, void* data) -> double {
-        NLopt_wrapper* nlopt_ptr = reinterpret_cast<NLopt_wrapper*>(data);
-        VectorXd vgrad;
-        double val = nlopt_ptr->_f(convert(x), vgrad);
-        grad       = convert(vgrad);
-        return val;
-    }, this);
+    for(size_t i = 0; i < cached_opts.size(); ++i)
+    {
+        const NLopt_wrapper& o = *cached_opts[i];
+        if(o._algo == a and o._dim == d and o._lb == lb and o._ub == ub)
+        {
+            NLopt_wrapper* p = cached_opts[i].release();
+            cached_opts.erase(cached_opts.begin() + i);
+            return NLopt_lease(p);
+        }
+    }
+    return NLopt_lease(new NLopt_wrapper(a, d, lb, ub));
+}
+void NLopt_release::operator()(NLopt_wrapper* p) const
+{
+    p->_f_obj = nullptr; // the objective is gone once the lease is returned
+    if(cached_opts.size() < max_cached)
+        cached_opts.emplace_back(p);
+    else
+        delete p;
+}
+double NLopt_wrapper::_nlopt_func(unsigned n, const double* x, double* grad, void* data)
+{
+    // the objective works on the buffers of NLopt directly, a derivative-free
+    // algorithm passes no gradient, the objective then writes to `_g`
+    NLopt_wrapper* nlopt_ptr = reinterpret_cast<NLopt_wrapper*>(data);
+    ++nlopt_ptr->_num_evals;
+    const Point xm(x, n);
+    Grad        gm(grad != nullptr ? grad : nlopt_ptr->_g.data(), n);
+    return nlopt_ptr->_f_call(nlopt_ptr->_f_obj, xm, gm);
 }
 void NLopt_wrapper::set_maxeval(size_t v){_opt.set_maxeval(v);}
 void NLopt_wrapper::set_ftol_abs(double v){_opt.set_ftol_abs(v);}
@@ -26,17 +51,19 @@ void NLopt_wrapper::set_xtol_abs(double v){_opt.set_xtol_abs(v);}
 void NLopt_wrapper::set_xtol_rel(double v){_opt.set_xtol_rel(v);}
 void NLopt_wrapper::optimize(Eigen::VectorXd& sp, double& val)
 {
-    vector<double> stlsp = convert(sp);
+    _stlsp.assign(sp.data(), sp.data() + sp.size());
+    _num_evals = 0;
     try
     {
-        _opt.optimize(stlsp, val);
-        sp = convert(stlsp);
+        _opt.optimize(_stlsp, val);
+        sp = Map<const VectorXd>(_stlsp.data(), _stlsp.size());
     }
     catch(...)
     {
-        VectorXd fake_g;
-        sp  = convert(stlsp);
-        val = _f(sp, fake_g);
+        sp  = Map<const VectorXd>(_stlsp.data(), _stlsp.size());
+        const Point xm(sp.data(), sp.size());
+        Grad        gm(_g.data(), _g.size());
+        val = _f_call(_f_obj, xm, gm);
         throw;
     }
 }
@@ -1,21 +1,62 @@
 #pragma once
 #include "Eigen/Dense"
 #include "nlopt.hpp"
+#include <memory>
+#include <vector>
+class NLopt_wrapper;
+// Returns a leased optimizer to the cache of the calling thread
+struct NLopt_release
+{
+    void operator()(NLopt_wrapper* p) const;
+};
+typedef std::unique_ptr<NLopt_wrapper, NLopt_release> NLopt_lease;
 class NLopt_wrapper
 {
 public:
-    typedef std::function<double(const Eigen::VectorXd&, Eigen::VectorXd&)> func;
+    // The objective is called as f(x, grad), both map the buffers of NLopt,
+    // or the internal gradient buffer for derivative-free algorithms
+    typedef Eigen::Map<const Eigen::VectorXd> Point;
+    typedef Eigen::Map<Eigen::VectorXd>       Grad;
     NLopt_wrapper(nlopt::algorithm, size_t dim, double lb, double ub);
 
-    void set_min_objective(func);
+    // An optimizer from the per-thread cache, it is returned to the cache
+    // when the lease is destroyed, the settings of its last use are kept
+    static NLopt_lease lease(nlopt::algorithm, size_t dim, double lb, double ub);
+
+    // `f` is only referenced, it should outlive the calls of `optimize`, it is
+    // called through a plain function pointer instead of std::function
+    template<class F>
+    void set_min_objective(const F& f)
+    {
+        _f_obj  = &f;
+        _f_call = [](const void* obj, const Point& x, Grad& grad) -> double {
+            return (*static_cast<const F*>(obj))(x, grad);
+        };
+        _opt.set_min_objective(&NLopt_wrapper::_nlopt_func, this);
+    }
     void set_maxeval(size_t max_eval);
     void set_ftol_abs(double v);
     void set_ftol_rel(double v);
     void set_xtol_abs(double v);
     void set_xtol_rel(double v);
     void optimize(Eigen::VectorXd& sp, double& val);
+    size_t num_evals() const { return _num_evals; } // objective evaluations of the last `optimize`
 
 protected:
     nlopt::opt _opt;
-    func _f;
+    const void* _f_obj = nullptr;
+    double (*_f_call)(const void*, const Point&, Grad&) = nullptr;
+    nlopt::algorithm _algo;
+    size_t _dim;
+    double _lb;
+    double _ub;
+
+    // buffers reused by the callbacks and `optimize`, so that no allocation
+    // happens once they are sized
+    Eigen::VectorXd     _g;
+    std::vector<double> _stlsp;
+    size_t              _num_evals = 0;
+
+    static double _nlopt_func(unsigned n, const double* x, double* grad, void* data);
+    friend struct NLopt_release;
 };
@@ -0,0 +1,59 @@
+#include "Plugin.h"
+#include <dlfcn.h>
+#include <stdexcept>
+using namespace std;
+using namespace Eigen;
+
+Plugin::Plugin(string path, string arg, size_t dim, size_t num_spec, size_t num_threads)
+    : _path(path), _arg(arg), _dim(dim), _num_spec(num_spec), _handles(num_threads, nullptr)
+{
+    _lib = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if(_lib == nullptr)
+        throw runtime_error("Fail to load plugin " + path + ": " + dlerror());
+    try
+    {
+        _init     = reinterpret_cast<InitFunc>(_symbol("mace_plugin_init"));
+        _eval     = reinterpret_cast<EvalFunc>(_symbol("mace_plugin_eval"));
+        _teardown = reinterpret_cast<TeardownFunc>(_symbol("mace_plugin_teardown"));
+    }
+    catch(...)
+    {
+        dlclose(_lib);
+        throw;
+    }
+}
+Plugin::~Plugin()
+{
+    for(void* h : _handles)
+        if(h != nullptr)
+            _teardown(h);
+    dlclose(_lib);
+}
+void* Plugin::_symbol(const char* name)
+{
+    dlerror();
+    void* sym = dlsym(_lib, name);
+    if(sym == nullptr)
+        throw runtime_error("Fail to find " + string(name) + " in plugin " + _path);
+    return sym;
+}
+MatrixXd Plugin::eval(size_t tid, const MatrixXd& xs)
+{
+    if(tid >= _handles.size())
+        throw runtime_error("Invalid thread id " + to_string(tid) + " for plugin " + _path);
+    if((size_t)xs.rows() != _dim)
+        throw runtime_error("Dimension of the points does not match plugin " + _path);
+    void*& handle = _handles[tid];
+    if(handle == nullptr)
+    {
+        // the initialization of the plugin may not be thread-safe
+        lock_guard<mutex> lock(_init_mtx);
+        handle = _init(_dim, _num_spec, _arg.c_str());
+        if(handle == nullptr)
+            throw runtime_error("Fail to initialize plugin " + _path);
+    }
+    MatrixXd ys(_num_spec, xs.cols());
+    if(_eval(handle, xs.cols(), xs.data(), ys.data()) != 0)
+        throw runtime_error("Plugin " + _path + " fails to evaluate");
+    return ys;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "mace_plugin.h"
+#include <Eigen/Dense>
+#include <mutex>
+#include <string>
+#include <vector>
+// An objective plugin loaded with `dlopen`, see `mace_plugin.h`
+//
+// Each evaluation thread owns a handle, created by `mace_plugin_init` when the
+// thread firstly evaluates, all the handles are torn down with the plugin
+class Plugin
+{
+public:
+    Plugin(std::string path, std::string arg, size_t dim, size_t num_spec, size_t num_threads);
+    ~Plugin();
+    Plugin(const Plugin&) = delete;
+    Plugin& operator=(const Plugin&) = delete;
+
+    // xs: dim * num, the results are num_spec * num
+    Eigen::MatrixXd eval(size_t tid, const Eigen::MatrixXd& xs);
+    size_t num_spec() const { return _num_spec; }
+
+private:
+    typedef void* (*InitFunc)(size_t, size_t, const char*);
+    typedef int (*EvalFunc)(void*, size_t, const double*, double*);
+    typedef void (*TeardownFunc)(void*);
+
+    std::string        _path;
+    std::string        _arg;
+    size_t             _dim;
+    size_t             _num_spec;
+    void*              _lib = nullptr;
+    InitFunc           _init;
+    EvalFunc           _eval;
+    TeardownFunc       _teardown;
+    std::vector<void*> _handles; // one for each thread
+    std::mutex         _init_mtx;
+
+    void* _symbol(const char* name);
+};
@@ -0,0 +1,57 @@
+#include "Process.h"
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
+using namespace std;
+
+static thread_local const atomic<bool>* cancel_flag = nullptr;
+
+const atomic<bool>* eval_cancel_flag() { return cancel_flag; }
+EvalCancelScope::EvalCancelScope(const atomic<bool>* flag)
+    : _prev(cancel_flag)
+{
+    cancel_flag = flag;
+}
+EvalCancelScope::~EvalCancelScope() { cancel_flag = _prev; }
+
+ProcStatus run_process(const string& cmd, double timeout)
+{
+    const auto t1 = chrono::steady_clock::now();
+    const pid_t pid = fork();
+    if(pid < 0)
+        return ProcStatus::Failure;
+    if(pid == 0)
+    {
+        setpgid(0, 0);
+        execl("/bin/sh", "sh", "-c", cmd.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    // also set by the parent, so that the group exists before it may be
+    // killed
+    setpgid(pid, pid);
+
+    // polled, as neither the timeout nor the cancellation can be waited for
+    // by `waitpid`, the evaluations take seconds to hours
+    const atomic<bool>* cancel = cancel_flag;
+    while(true)
+    {
+        int status = 0;
+        const pid_t ret = waitpid(pid, &status, WNOHANG);
+        if(ret == pid)
+            return (WIFEXITED(status) and WEXITSTATUS(status) == 0) ? ProcStatus::Success : ProcStatus::Failure;
+        if(ret < 0)
+            return ProcStatus::Failure;
+        const bool cancelled = cancel != nullptr and cancel->load();
+        const bool timed_out = timeout > 0 and chrono::duration<double>(chrono::steady_clock::now() - t1).count() > timeout;
+        if(cancelled or timed_out)
+        {
+            kill(-pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+            return cancelled ? ProcStatus::Cancelled : ProcStatus::Timeout;
+        }
+        this_thread::sleep_for(chrono::milliseconds(20));
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <atomic>
+#include <string>
+
+// Evaluation processes that can be stopped.
+//
+// `run_process` runs `cmd` by `/bin/sh` in a new process group, when the
+// command takes longer than `timeout` seconds (0 for no limit), or the
+// cancellation flag of the calling thread is raised, the whole group is
+// killed, so that the simulators started by the script are also stopped
+enum class ProcStatus
+{
+    Success = 0,
+    Failure,
+    Timeout,
+    Cancelled
+};
+ProcStatus run_process(const std::string& cmd, double timeout);
+
+// Cancellation flag of the evaluation running in the current thread, raised
+// by MACE when a speculative duplicate of the point finishes first, nullptr
+// if the evaluation can not be cancelled
+const std::atomic<bool>* eval_cancel_flag();
+class EvalCancelScope
+{
+public:
+    explicit EvalCancelScope(const std::atomic<bool>* flag);
+    ~EvalCancelScope();
+    EvalCancelScope(const EvalCancelScope&) = delete;
+    EvalCancelScope& operator=(const EvalCancelScope&) = delete;
+
+private:
+    const std::atomic<bool>* _prev;
+};
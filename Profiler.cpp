@@ -0,0 +1,54 @@
+#include "Profiler.h"
+#include <stdexcept>
+using namespace std;
+
+Profiler::Profiler()
+{
+    _last.times.fill(0);
+    _last.counts.fill(0);
+    reset();
+}
+void Profiler::open(string path)
+{
+    _file.open(path, ios::app);
+    if(not _file.is_open())
+        throw runtime_error("Fail to open " + path);
+}
+void Profiler::reset()
+{
+    for(auto& t : _times)
+        t.store(0, memory_order_relaxed);
+    for(auto& c : _counters)
+        c.store(0, memory_order_relaxed);
+    _iter_start = Clock::now();
+}
+void Profiler::record(size_t num_eval)
+{
+    ++_iter;
+    _last.wall = chrono::duration<double>(Clock::now() - _iter_start).count();
+    for(size_t i = 0; i < NumPhases; ++i)
+        _last.times[i] = 1e-9 * _times[i].load();
+    for(size_t i = 0; i < NumCounters; ++i)
+        _last.counts[i] = _counters[i].load();
+    if(_file.is_open())
+    {
+        _file << "{\"iter\":" << _iter << ",\"evals\":" << num_eval << ",\"wall\":" << _last.wall << ",\"time\":{";
+        for(size_t i = 0; i < NumPhases; ++i)
+            _file << (i == 0 ? "" : ",") << "\"" << name(static_cast<Phase>(i)) << "\":" << _last.times[i];
+        _file << "},\"count\":{";
+        for(size_t i = 0; i < NumCounters; ++i)
+            _file << (i == 0 ? "" : ",") << "\"" << name(static_cast<Counter>(i)) << "\":" << _last.counts[i];
+        _file << "}}" << endl;
+    }
+    reset();
+}
+const char* Profiler::name(Phase p)
+{
+    static const char* names[NumPhases] = {"train", "posterior_mean", "anchor", "moo", "select", "adjust", "adaptive", "eval"};
+    return names[p];
+}
+const char* Profiler::name(Counter c)
+{
+    static const char* names[NumCounters] = {"predict", "msp_start", "nlopt_eval", "mvmo_eval"};
+    return names[c];
+}
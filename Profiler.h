@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+// Per-iteration timing of the phases of MACE and counters of the inner
+// optimizers, written as one JSON line for each iteration.
+//
+// Phases and counters are updated with relaxed atomics, so that they can be
+// updated from the tasks of the model-side pool, nested phases are counted in
+// both of them
+class Profiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    enum Phase
+    {
+        Train = 0,     // GP training and hyperparameter selection
+        PosteriorMean, // `_set_best_posterior_mean`
+        Anchor,        // `_set_anchor`
+        MultiObj,      // MOO of the acquisition functions or PF
+        Select,        // selection of the candidates from the Pareto set
+        Adjust,        // `_adjust_x`
+        Adaptive,      // max-uncertainty sampling and BLCB proposals
+        Eval,          // objective evaluations
+        NumPhases
+    };
+    enum Counter
+    {
+        Predict = 0,   // points predicted by GP
+        MSPStart,      // starts of the multi-start gradient-based search
+        NLoptEval,     // objective evaluations of NLopt
+        MVMOEval,      // objective evaluations of MVMO
+        NumCounters
+    };
+    class Scope
+    {
+    public:
+        Scope(Profiler& p, Phase phase) : _p(p), _phase(phase), _start(Clock::now()) {}
+        ~Scope() { _p.add_time(_phase, Clock::now() - _start); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Profiler&         _p;
+        Phase             _phase;
+        Clock::time_point _start;
+    };
+
+    struct Record
+    {
+        double                             wall = 0; // seconds
+        std::array<double, NumPhases>      times;    // seconds
+        std::array<long long, NumCounters> counts;
+    };
+
+    Profiler();
+    void open(std::string path); // records are only written after a file is opened
+    void add(Counter c, size_t n = 1) { _counters[c].fetch_add(n, std::memory_order_relaxed); }
+    void add_time(Phase p, Clock::duration d)
+    {
+        _times[p].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(), std::memory_order_relaxed);
+    }
+    void reset();                               // clear the times and counters, and restart the iteration clock
+    void record(size_t num_eval); // write the record of one iteration, and reset
+    const Record& last() const { return _last; } // the record of the last iteration
+
+    static const char* name(Phase p);
+    static const char* name(Counter c);
+
+private:
+    std::array<std::atomic<long long>, NumPhases>   _times;    // nanoseconds
+    std::array<std::atomic<long long>, NumCounters> _counters;
+    Record            _last;
+    Clock::time_point _iter_start;
+    size_t            _iter = 0;
+    std::ofstream     _file;
+};
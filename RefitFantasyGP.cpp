@@ -0,0 +1,47 @@
+#include "RefitFantasyGP.h"
+#include "util.h"
+#include <stdexcept>
+using namespace std;
+using namespace Eigen;
+RefitFantasyGP::RefitFantasyGP(GP* parent, bool noise_free, double noise_lvl)
+    : _parent(parent), _noise_free(noise_free), _noise_lvl(noise_lvl)
+{
+    if(_parent == nullptr or not _parent->trained())
+        throw invalid_argument("Fantasies need a trained GP");
+}
+RefitFantasyGP::~RefitFantasyGP()
+{
+    delete _gp;
+}
+void RefitFantasyGP::add_fantasy(const MatrixXd& xs)
+{
+    MatrixXd ys, s2s;
+    gp()->predict(xs, ys, s2s);
+    if(_gp == nullptr)
+    {
+        _gp = new GP(_parent->train_in(), _parent->train_out());
+        _gp->set_fixed(true);
+        _gp->set_noise_free(_noise_free);
+        _gp->set_noise_lower_bound(_noise_lvl);
+    }
+    // the hyperparameters are fixed to those of the parent, so that only the
+    // factorization is updated
+    _gp->add_data(xs, ys);
+    _gp->train(_parent->get_hyp());
+    _num_fantasy += xs.cols();
+}
+size_t RefitFantasyGP::num_fantasy() const { return _num_fantasy; }
+GP* RefitFantasyGP::gp() const { return _gp == nullptr ? _parent : _gp; }
+void RefitFantasyGP::predict(size_t spec_idx, const VectorXd& x, double& y, double& s2) const
+{
+    gp()->predict(spec_idx, x, y, s2);
+}
+void RefitFantasyGP::predict_with_grad(size_t spec_idx, const VectorXd& x, double& y, double& s2, VectorXd& gy,
+                                  VectorXd& gs2) const
+{
+    gp()->predict_with_grad(spec_idx, x, y, s2, gy, gs2);
+}
+void RefitFantasyGP::predict(const MatrixXd& xs, MatrixXd& y, MatrixXd& s2) const
+{
+    gp()->predict(xs, y, s2);
+}
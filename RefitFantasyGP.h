@@ -0,0 +1,37 @@
+#pragma once
+#include "GP.h"
+#include <Eigen/Dense>
+// A trained GP with hallucinated observations, used to construct batches.
+//
+// Until the first observation is hallucinated, the parent GP is used
+// directly and nothing is copied. The first `add_fantasy` copies the training
+// data of the parent, and every `add_fantasy` refits the copy with the
+// hyperparameters of the parent fixed, so each call still refactorizes the
+// whole covariance matrix, O(n^3), there is no incremental update of the
+// factor. Hallucinated observations are never written back to the parent
+class RefitFantasyGP
+{
+public:
+    RefitFantasyGP(GP* parent, bool noise_free, double noise_lvl);
+    ~RefitFantasyGP();
+    RefitFantasyGP(const RefitFantasyGP&) = delete;
+    RefitFantasyGP& operator=(const RefitFantasyGP&) = delete;
+
+    // hallucinate observations at xs with the posterior mean of the copy
+    void add_fantasy(const Eigen::MatrixXd& xs);
+
+    size_t num_fantasy() const;
+    GP* gp() const; // the GP with hallucinated observations
+
+    void predict(size_t spec_idx, const Eigen::VectorXd& x, double& y, double& s2) const;
+    void predict_with_grad(size_t spec_idx, const Eigen::VectorXd& x, double& y, double& s2, Eigen::VectorXd& gy,
+                           Eigen::VectorXd& gs2) const;
+    void predict(const Eigen::MatrixXd& xs, Eigen::MatrixXd& y, Eigen::MatrixXd& s2) const;
+
+private:
+    GP*    _parent;
+    GP*    _gp = nullptr;
+    bool   _noise_free;
+    double _noise_lvl;
+    size_t _num_fantasy = 0;
+};
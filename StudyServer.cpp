@@ -0,0 +1,292 @@
+#include "StudyServer.h"
+#include "Logging.h"
+#include <cctype>
+#include <chrono>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+using namespace std;
+using namespace Eigen;
+
+StudyScheduler::StudyScheduler(size_t num_runners)
+{
+    for(size_t i = 0; i < max<size_t>(1, num_runners); ++i)
+        _runners.emplace_back(&StudyScheduler::_runner_loop, this);
+}
+StudyScheduler::~StudyScheduler()
+{
+    map<string, shared_ptr<Study>> studies;
+    {
+        lock_guard<mutex> lock(_mtx);
+        _stopping = true;
+        for(auto& s : _studies)
+            for(auto& r : s.second->queue)
+                r->done.set_exception(make_exception_ptr(runtime_error("Server is stopped")));
+        studies.swap(_studies);
+    }
+    _cv.notify_all();
+    for(thread& t : _runners)
+        t.join();
+    // the MACE objects are destroyed here, without holding the lock
+}
+void StudyScheduler::create(string name, size_t num_spec, const VectorXd& lb, const VectorXd& ub, double priority,
+                            size_t num_init, string log_name)
+{
+    if(priority <= 0)
+        throw invalid_argument("Priority should be positive");
+    if(lb.size() == 0 or lb.size() != ub.size() or not (lb.array() < ub.array()).all())
+        throw invalid_argument("Invalid bounds");
+    if(num_spec == 0)
+        throw invalid_argument("NUM_SPEC should be positive");
+    {
+        lock_guard<mutex> lock(_mtx);
+        if(_studies.count(name))
+            throw invalid_argument("Study " + name + " exists");
+    }
+    shared_ptr<Study> study = make_shared<Study>();
+    study->name     = name;
+    study->priority = priority;
+    {
+        StudyTag tag(name);
+        study->mace.reset(new MACE(num_spec, lb, ub, log_name));
+        study->mace->set_throw_on_error(true); // a failed study must not stop the others
+        study->mace->set_log_study(name);
+        study->mace->set_init_num(num_init);
+    }
+    lock_guard<mutex> lock(_mtx);
+    if(not _studies.emplace(name, study).second)
+        throw invalid_argument("Study " + name + " exists");
+}
+void StudyScheduler::remove(string name)
+{
+    // a running request keeps the study alive, otherwise the study is
+    // destroyed when `removed` goes out of scope, after the lock is released
+    shared_ptr<Study> removed;
+    lock_guard<mutex> lock(_mtx);
+    auto it = _studies.find(name);
+    if(it == _studies.end())
+        throw invalid_argument("No study " + name);
+    for(auto& r : it->second->queue)
+        r->done.set_exception(make_exception_ptr(runtime_error("Study " + name + " is closed")));
+    it->second->queue.clear();
+    removed = it->second;
+    _studies.erase(it);
+}
+void StudyScheduler::set_priority(string name, double priority)
+{
+    if(priority <= 0)
+        throw invalid_argument("Priority should be positive");
+    lock_guard<mutex> lock(_mtx);
+    _find(name)->priority = priority;
+}
+vector<StudyScheduler::Info> StudyScheduler::list() const
+{
+    lock_guard<mutex> lock(_mtx);
+    vector<Info> infos;
+    for(auto& s : _studies)
+        infos.push_back(Info{s.first, s.second->priority, s.second->num_eval, s.second->model_time});
+    return infos;
+}
+void StudyScheduler::run(string name, function<void(MACE&)> f)
+{
+    shared_ptr<Request> req = make_shared<Request>();
+    req->f                  = f;
+    future<void> done       = req->done.get_future();
+    {
+        lock_guard<mutex> lock(_mtx);
+        shared_ptr<Study> study = _find(name);
+        if(not study->busy and study->queue.empty())
+            study->vtime = max(study->vtime, _vclock);
+        study->queue.push_back(req);
+    }
+    _cv.notify_one();
+    done.get();
+}
+shared_ptr<StudyScheduler::Study> StudyScheduler::_find(const string& name) const
+{
+    auto it = _studies.find(name);
+    if(it == _studies.end())
+        throw invalid_argument("No study " + name);
+    return it->second;
+}
+shared_ptr<StudyScheduler::Study> StudyScheduler::_next()
+{
+    shared_ptr<Study> next;
+    for(auto& s : _studies)
+    {
+        const shared_ptr<Study>& study = s.second;
+        if(not study->busy and not study->queue.empty() and (next == nullptr or study->vtime < next->vtime))
+            next = study;
+    }
+    return next;
+}
+void StudyScheduler::_runner_loop()
+{
+    while(true)
+    {
+        // declared outside the locked scopes, the last reference to a study
+        // removed while its request runs is dropped at the end of the
+        // iteration, so that the MACE object is destroyed without the lock
+        shared_ptr<Study>   study;
+        shared_ptr<Request> req;
+        {
+            unique_lock<mutex> lock(_mtx);
+            _cv.wait(lock, [&]() { return _stopping or (study = _next()) != nullptr; });
+            if(_stopping)
+                return;
+            req = study->queue.front();
+            study->queue.pop_front();
+            study->busy = true;
+            _vclock     = study->vtime;
+        }
+
+        const auto t1 = chrono::steady_clock::now();
+        try
+        {
+            StudyTag tag(study->name);
+            req->f(*study->mace);
+            req->done.set_value();
+        }
+        catch(...)
+        {
+            req->done.set_exception(current_exception());
+        }
+        const double t = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+
+        lock_guard<mutex> lock(_mtx);
+        study->busy        = false;
+        study->model_time += t;
+        study->vtime      += t / study->priority;
+        study->num_eval    = study->mace->num_eval();
+        if(not study->queue.empty())
+            _cv.notify_one();
+    }
+}
+
+static VectorXd parse_vec(const string& str)
+{
+    vector<double> vals;
+    stringstream ss(str);
+    string tok;
+    while(getline(ss, tok, ','))
+        vals.push_back(stod(tok));
+    return Map<VectorXd>(vals.data(), vals.size());
+}
+static MatrixXd parse_points(const string& str, size_t rows)
+{
+    vector<VectorXd> pnts;
+    stringstream ss(str);
+    string tok;
+    while(getline(ss, tok, ';'))
+    {
+        pnts.push_back(parse_vec(tok));
+        if((size_t)pnts.back().size() != rows)
+            throw invalid_argument("Each point should have " + to_string(rows) + " values");
+    }
+    MatrixXd m(rows, pnts.size());
+    for(size_t i = 0; i < pnts.size(); ++i)
+        m.col(i) = pnts[i];
+    return m;
+}
+static string format_points(const MatrixXd& m)
+{
+    stringstream ss;
+    ss.precision(numeric_limits<double>::max_digits10);
+    for(long i = 0; i < m.cols(); ++i)
+    {
+        if(i > 0)
+            ss << ';';
+        for(long j = 0; j < m.rows(); ++j)
+            ss << (j > 0 ? "," : "") << m(j, i);
+    }
+    return ss.str();
+}
+static bool valid_name(const string& name)
+{
+    // the name is also the file name of the log
+    if(name.empty())
+        return false;
+    for(char c : name)
+        if(not (isalnum(c) or c == '_' or c == '-' or c == '.'))
+            return false;
+    return name[0] != '.';
+}
+
+StudyServer::StudyServer(size_t num_runners, string log_dir)
+    : _sched(num_runners), _log_dir(log_dir)
+{}
+string StudyServer::handle(const string& request)
+{
+    stringstream ss(request);
+    vector<string> toks;
+    string tok;
+    while(ss >> tok)
+        toks.push_back(tok);
+    try
+    {
+        if(toks.empty())
+            throw invalid_argument("Empty request");
+        const string& cmd = toks[0];
+        if(cmd == "list" and toks.size() == 1)
+        {
+            stringstream reply;
+            reply << "ok";
+            for(const StudyScheduler::Info& info : _sched.list())
+                reply << ' ' << info.name << ':' << info.priority << ':' << info.num_eval << ':' << info.model_time;
+            return reply.str();
+        }
+        if(toks.size() < 2)
+            throw invalid_argument("Invalid request: " + request);
+        const string& name = toks[1];
+        if(cmd == "create" and toks.size() >= 5 and toks.size() <= 7)
+        {
+            if(not valid_name(name))
+                throw invalid_argument("Invalid study name " + name);
+            const VectorXd lb = parse_vec(toks[3]);
+            _sched.create(name, stoul(toks[2]), lb, parse_vec(toks[4]), toks.size() > 5 ? stod(toks[5]) : 1.0,
+                          toks.size() > 6 ? stoul(toks[6]) : lb.size() + 1, _log_dir + "/" + name + ".log");
+            return "ok";
+        }
+        else if(cmd == "ask" and toks.size() == 3)
+        {
+            const size_t num = stoul(toks[2]);
+            if(num == 0)
+                throw invalid_argument("NUM should be positive");
+            MatrixXd xs;
+            _sched.run(name, [&](MACE& mace) { xs = mace.ask(num); });
+            return "ok " + format_points(xs);
+        }
+        else if(cmd == "tell" and toks.size() == 4)
+        {
+            _sched.run(name, [&](MACE& mace) {
+                const MatrixXd xs = parse_points(toks[2], mace.best_x().size());
+                mace.tell(xs, parse_points(toks[3], mace.best_y().size()));
+            });
+            return "ok";
+        }
+        else if(cmd == "best" and toks.size() == 2)
+        {
+            VectorXd x, y;
+            _sched.run(name, [&](MACE& mace) {
+                x = mace.best_x();
+                y = mace.best_y();
+            });
+            return "ok " + format_points(x) + " " + format_points(y);
+        }
+        else if(cmd == "priority" and toks.size() == 3)
+        {
+            _sched.set_priority(name, stod(toks[2]));
+            return "ok";
+        }
+        else if(cmd == "close" and toks.size() == 2)
+        {
+            _sched.remove(name);
+            return "ok";
+        }
+        throw invalid_argument("Invalid request: " + request);
+    }
+    catch(const exception& e)
+    {
+        return string("error ") + e.what();
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "MACE.h"
+#include <Eigen/Dense>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Studies hosted in one process, each a MACE object driven by ask/tell.
+//
+// The requests are run by `num_runners` threads, the model-side computation
+// of all the studies shares the `TaskPool`. The requests of one study run one
+// at a time in order, among the studies with waiting requests, the next one
+// to run is the one that has consumed the least model time divided by its
+// priority, so a busy study with priority 2 gets twice the model time of a
+// busy study with priority 1. A study does not save up model time while it
+// is idle
+class StudyScheduler
+{
+public:
+    struct Info
+    {
+        std::string name;
+        double      priority;
+        size_t      num_eval;
+        double      model_time; // seconds
+    };
+    explicit StudyScheduler(size_t num_runners);
+    ~StudyScheduler();
+    StudyScheduler(const StudyScheduler&) = delete;
+    StudyScheduler& operator=(const StudyScheduler&) = delete;
+
+    // the log of the study is written to `log_name`, throw
+    // std::invalid_argument if the study exists
+    void create(std::string name, size_t num_spec, const Eigen::VectorXd& lb, const Eigen::VectorXd& ub,
+                double priority, size_t num_init, std::string log_name);
+    void remove(std::string name); // waiting requests fail, a running request finishes
+    void set_priority(std::string name, double priority);
+    std::vector<Info> list() const;
+
+    // run `f` on the MACE object of the study and wait for it, exceptions
+    // thrown by `f` are re-thrown
+    void run(std::string name, std::function<void(MACE&)> f);
+
+private:
+    struct Request
+    {
+        std::function<void(MACE&)> f;
+        std::promise<void>         done;
+    };
+    struct Study
+    {
+        std::string                          name;
+        std::unique_ptr<MACE>                mace;
+        double                               priority;
+        double                               vtime      = 0; // model time / priority
+        double                               model_time = 0;
+        size_t                               num_eval   = 0;
+        bool                                 busy       = false;
+        std::deque<std::shared_ptr<Request>> queue;
+    };
+    mutable std::mutex                            _mtx;
+    std::condition_variable                       _cv;
+    std::map<std::string, std::shared_ptr<Study>> _studies;
+    double                                        _vclock   = 0; // vtime of the last dispatched study
+    bool                                          _stopping = false;
+    std::vector<std::thread>                      _runners;
+
+    std::shared_ptr<Study> _find(const std::string& name) const;
+    std::shared_ptr<Study> _next(); // the study to run, nullptr if none
+    void _runner_loop();
+};
+
+// Text protocol of `mace_server`, one request per line and one reply per
+// line, the reply is "ok [result]" or "error message". Points are separated
+// by ';', the values of one point by ','
+//
+//     create NAME NUM_SPEC LB UB [PRIORITY [NUM_INIT]]
+//     ask NAME NUM          -> ok X
+//     tell NAME X Y
+//     best NAME             -> ok X Y
+//     priority NAME PRIORITY
+//     close NAME
+//     list                  -> ok NAME:PRIORITY:NUM_EVAL:MODEL_TIME ...
+class StudyServer
+{
+public:
+    StudyServer(size_t num_runners, std::string log_dir);
+    std::string handle(const std::string& request);
+
+private:
+    StudyScheduler _sched;
+    std::string    _log_dir;
+};
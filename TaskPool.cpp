@@ -0,0 +1,217 @@
+#include "TaskPool.h"
+#include <algorithm>
+using namespace std;
+
+// External deques not claimed by any thread, shared by all the sizes of the
+// pool, as the pool itself is never destroyed
+static mutex          external_mtx;
+static vector<size_t> external_free;
+static size_t         external_next = 0;
+
+// deque of the current thread: the id of a pool worker, or the external
+// slot claimed on the first submission, given back when the thread exits
+struct ThreadQueue
+{
+    long worker   = -1;
+    long external = -1; // max_external if all the slots are claimed
+    ~ThreadQueue()
+    {
+        if(external < 0 or external >= (long)TaskPool::max_external)
+            return;
+        lock_guard<mutex> lk(external_mtx);
+        external_free.push_back(external);
+    }
+};
+static thread_local ThreadQueue tl_queue;
+
+TaskPool& TaskPool::instance()
+{
+    // never destroyed, `exit` may be called from inside a task, where joining
+    // the workers would dead-lock
+    static TaskPool* pool = new TaskPool(std::max(1u, thread::hardware_concurrency()));
+    return *pool;
+}
+TaskPool::TaskPool(size_t num_threads)
+    : _num_queued(0)
+{
+    _start(num_threads);
+}
+TaskPool::~TaskPool()
+{
+    _stop();
+}
+void TaskPool::resize(size_t num_threads)
+{
+    if(num_threads == 0 or num_threads == this->num_threads())
+        return;
+    _stop();
+    _start(num_threads);
+}
+void TaskPool::_start(size_t num_threads)
+{
+    _stopping = false;
+    _queues.clear();
+    for(size_t i = 0; i < num_threads + max_external; ++i)
+        _queues.emplace_back(new Queue);
+    for(size_t i = 1; i < num_threads; ++i)
+        _workers.emplace_back(&TaskPool::_worker_loop, this, i);
+}
+void TaskPool::_stop()
+{
+    {
+        lock_guard<mutex> lk(_sleep_mtx);
+        _stopping = true;
+    }
+    _sleep_cv.notify_all();
+    for(auto& w : _workers)
+        w.join();
+    _workers.clear();
+}
+size_t TaskPool::_queue_idx() const
+{
+    if(tl_queue.worker >= 0)
+        return tl_queue.worker;
+    if(tl_queue.external < 0)
+    {
+        lock_guard<mutex> lk(external_mtx);
+        if(not external_free.empty())
+        {
+            tl_queue.external = external_free.back();
+            external_free.pop_back();
+        }
+        else
+            tl_queue.external = external_next < max_external ? external_next++ : max_external;
+    }
+    return tl_queue.external < (long)max_external ? num_threads() + tl_queue.external : 0;
+}
+void TaskPool::_push(Task&& t)
+{
+    // counted under the lock of the deque before the task is published, so
+    // that the thief popping it can not decrement the count first and make
+    // it wrap around
+    Queue& q = *_queues[_queue_idx()];
+    {
+        lock_guard<mutex> lk(q.mtx);
+        ++_num_queued;
+        q.tasks.push_back(std::move(t));
+    }
+    {
+        lock_guard<mutex> lk(_sleep_mtx);
+    }
+    _sleep_cv.notify_one();
+}
+bool TaskPool::_pop(Task& t)
+{
+    if(_num_queued == 0)
+        return false;
+    const size_t n    = _queues.size();
+    const size_t self = _queue_idx();
+    for(size_t k = 0; k < n; ++k)
+    {
+        // own queue first (newest task, better locality), then steal the
+        // oldest task of the others
+        const size_t idx = (self + k) % n;
+        Queue& q         = *_queues[idx];
+        lock_guard<mutex> lk(q.mtx);
+        if(q.tasks.empty())
+            continue;
+        if(k == 0)
+        {
+            t = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        }
+        else
+        {
+            t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        --_num_queued;
+        return true;
+    }
+    return false;
+}
+bool TaskPool::_run_one()
+{
+    Task t;
+    if(not _pop(t))
+        return false;
+    t();
+    return true;
+}
+void TaskPool::_worker_loop(size_t id)
+{
+    tl_queue.worker = id;
+    while(true)
+    {
+        if(_run_one())
+            continue;
+        unique_lock<mutex> lk(_sleep_mtx);
+        _sleep_cv.wait(lk, [&]() { return _stopping or _num_queued > 0; });
+        if(_stopping)
+            return;
+    }
+}
+
+TaskGroup::TaskGroup(TaskPool& pool)
+    : _pool(pool), _pending(0)
+{}
+TaskGroup::~TaskGroup()
+{
+    try
+    {
+        wait();
+    }
+    catch(...)
+    {}
+}
+void TaskGroup::run(function<void()> f)
+{
+    ++_pending;
+    TaskPool* pool = &_pool;
+    _pool._push([this, pool, f]() {
+        try
+        {
+            f();
+        }
+        catch(...)
+        {
+            lock_guard<mutex> lk(_err_mtx);
+            if(not _error)
+                _error = current_exception();
+        }
+        // the group may be destroyed by its waiter as soon as the count
+        // drops to 0, only the pool is used afterwards
+        if(--_pending == 0)
+        {
+            {
+                lock_guard<mutex> lk(pool->_sleep_mtx);
+            }
+            pool->_sleep_cv.notify_all();
+        }
+    });
+}
+void TaskGroup::wait()
+{
+    while(_pending > 0)
+    {
+        if(_pool._run_one())
+            continue;
+        // the remaining tasks of the group are running in other threads
+        unique_lock<mutex> lk(_pool._sleep_mtx);
+        _pool._sleep_cv.wait(lk, [&]() { return _pending == 0 or _pool._num_queued > 0; });
+    }
+    if(_error)
+    {
+        exception_ptr e = _error;
+        _error          = nullptr;
+        rethrow_exception(e);
+    }
+}
+
+void parallel_for(size_t n, const function<void(size_t)>& f)
+{
+    TaskGroup g;
+    for(size_t i = 0; i < n; ++i)
+        g.run([&f, i]() { f(i); });
+    g.wait();
+}
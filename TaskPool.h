@@ -0,0 +1,77 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+// Work-stealing thread pool for the model-side computation (multi-start
+// optimization, anchor search, hyperparameter training), sized independently
+// of the evaluation batch.
+//
+// Each worker owns a deque, it pushes and pops tasks at the back while idle
+// threads steal from the front of the others. A thread outside the pool
+// claims one of `max_external` deques of its own on its first submission and
+// gives it back when it exits, only when all of them are claimed, it submits
+// to a shared deque. A thread waiting for a `TaskGroup` runs pending tasks
+// instead of blocking, so nested submissions never create extra threads, and
+// sleeps when there is nothing to run
+class TaskPool
+{
+public:
+    typedef std::function<void()> Task;
+    static const size_t max_external = 16; // threads outside the pool with a deque of their own
+    static TaskPool& instance();
+    ~TaskPool();
+
+    // total number of threads, including the thread waiting for the tasks,
+    // should only be called when no task is running
+    void   resize(size_t num_threads);
+    size_t num_threads() const { return _workers.size() + 1; }
+
+private:
+    friend class TaskGroup;
+    struct Queue
+    {
+        std::mutex       mtx;
+        std::deque<Task> tasks;
+    };
+    explicit TaskPool(size_t num_threads);
+    void _start(size_t num_threads);
+    void _stop();
+    void _push(Task&& t);
+    bool _pop(Task& t);
+    bool _run_one(); // run one pending task, false if there is none
+    void _worker_loop(size_t id);
+    size_t _queue_idx() const; // deque of the current thread
+
+    std::vector<std::thread>            _workers;
+    std::vector<std::unique_ptr<Queue>> _queues; // 0: shared, 1 ... num_threads - 1: workers, then the external threads
+    std::mutex                          _sleep_mtx;
+    std::condition_variable             _sleep_cv; // a task is queued, a group is finished, or stopping
+    std::atomic<size_t>                 _num_queued;
+    bool                                _stopping = false;
+};
+
+// A set of tasks that can be waited for, the first exception thrown by a task
+// is re-thrown by `wait`
+class TaskGroup
+{
+public:
+    explicit TaskGroup(TaskPool& pool = TaskPool::instance());
+    ~TaskGroup();
+    void run(std::function<void()> f);
+    void wait();
+
+private:
+    TaskPool&           _pool;
+    std::atomic<size_t> _pending;
+    std::mutex          _err_mtx;
+    std::exception_ptr  _error;
+};
+
+// run f(0), ..., f(n-1) in the pool and wait for them
+void parallel_for(size_t n, const std::function<void(size_t)>& f);
@@ -0,0 +1,199 @@
+#include "Worker.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+using namespace std;
+using namespace Eigen;
+Worker::Worker(string dir, string script, const vector<string>& names)
+    : _dir(dir), _script(script), _names(names)
+{
+    _start(); // retried by `eval` on failure
+}
+Worker::~Worker()
+{
+    _stop();
+}
+bool Worker::_start()
+{
+    // a dead worker should be reported by `eval`, not kill the optimizer
+    signal(SIGPIPE, SIG_IGN);
+    int to_worker[2];
+    int from_worker[2];
+    // close-on-exec, so that workers started later do not inherit the pipes
+    // of this worker, which would prevent it from seeing EOF on stdin
+    if(pipe2(to_worker, O_CLOEXEC) != 0)
+    {
+        cerr << "Fail to create pipes for worker in " << _dir << endl;
+        return false;
+    }
+    if(pipe2(from_worker, O_CLOEXEC) != 0)
+    {
+        cerr << "Fail to create pipes for worker in " << _dir << endl;
+        close(to_worker[0]);
+        close(to_worker[1]);
+        return false;
+    }
+    _pid = fork();
+    if(_pid < 0)
+    {
+        cerr << "Fail to fork worker in " << _dir << endl;
+        for(int fd : {to_worker[0], to_worker[1], from_worker[0], from_worker[1]})
+            close(fd);
+        return false;
+    }
+    if(_pid == 0)
+    {
+        setpgid(0, 0);
+        dup2(to_worker[0], STDIN_FILENO);
+        dup2(from_worker[1], STDOUT_FILENO);
+        close(to_worker[0]);
+        close(to_worker[1]);
+        close(from_worker[0]);
+        close(from_worker[1]);
+        if(chdir(_dir.c_str()) != 0)
+            _exit(EXIT_FAILURE);
+        const int log_fd = open("output_info.log", O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if(log_fd >= 0)
+        {
+            dup2(log_fd, STDERR_FILENO);
+            close(log_fd);
+        }
+        execlp("perl", "perl", _script.c_str(), (char*)nullptr);
+        _exit(EXIT_FAILURE);
+    }
+    // also set by the parent, so that the group exists before it may be
+    // killed
+    setpgid(_pid, _pid);
+    close(to_worker[0]);
+    close(from_worker[1]);
+    _to   = to_worker[1];
+    _from = from_worker[0];
+
+    string header;
+    for(size_t i = 0; i < _names.size(); ++i)
+        header += (i == 0 ? "" : " ") + _names[i];
+    // a worker failing to read the names is reported by the first `eval`
+    _send(header + "\n");
+    return true;
+}
+void Worker::_stop()
+{
+    // the worker exits when its stdin is closed
+    if(_to >= 0)
+        close(_to);
+    if(_from >= 0)
+        close(_from);
+    if(_pid > 0)
+        waitpid(_pid, nullptr, 0);
+    _to   = -1;
+    _from = -1;
+    _pid  = -1;
+    _buf.clear();
+}
+void Worker::_kill()
+{
+    // with the simulators it started, the next `eval` starts a new worker
+    if(_pid > 0)
+        kill(-_pid, SIGKILL);
+    _stop();
+}
+bool Worker::_send(const string& line)
+{
+    size_t sent = 0;
+    while(sent < line.size())
+    {
+        const ssize_t n = write(_to, line.data() + sent, line.size() - sent);
+        if(n < 0 and errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+ProcStatus Worker::_recv(string& line, double timeout)
+{
+    // polled, as for `run_process`, so that a hanging worker can be killed
+    const auto t1 = chrono::steady_clock::now();
+    const atomic<bool>* cancel = eval_cancel_flag();
+    while(true)
+    {
+        const size_t eol = _buf.find('\n');
+        if(eol != string::npos)
+        {
+            line = _buf.substr(0, eol);
+            _buf.erase(0, eol + 1);
+            return ProcStatus::Success;
+        }
+        const bool cancelled = cancel != nullptr and cancel->load();
+        const bool timed_out = timeout > 0 and chrono::duration<double>(chrono::steady_clock::now() - t1).count() > timeout;
+        if(cancelled or timed_out)
+            return cancelled ? ProcStatus::Cancelled : ProcStatus::Timeout;
+
+        pollfd pfd = {_from, POLLIN, 0};
+        const int ret = poll(&pfd, 1, 20);
+        if(ret < 0 and errno != EINTR)
+            return ProcStatus::Failure;
+        if(ret <= 0)
+            continue;
+        char chunk[4096];
+        const ssize_t n = read(_from, chunk, sizeof(chunk));
+        if(n < 0 and errno == EINTR)
+            continue;
+        if(n <= 0) // EOF, the worker exited
+            return ProcStatus::Failure;
+        _buf.append(chunk, n);
+    }
+}
+ProcStatus Worker::eval(const VectorXd& x, size_t num_spec, double timeout, VectorXd& y)
+{
+    if(_pid < 0 and not _start())
+        return ProcStatus::Failure;
+    stringstream param;
+    param << setprecision(18);
+    for(long i = 0; i < x.size(); ++i)
+        param << (i == 0 ? "" : " ") << x(i);
+    param << "\n";
+    if(not _send(param.str()))
+    {
+        cerr << "Fail to send parameters to worker in " << _dir << ", see " << _dir << "/output_info.log" << endl;
+        _kill();
+        return ProcStatus::Failure;
+    }
+
+    string line;
+    const ProcStatus status = _recv(line, timeout);
+    if(status != ProcStatus::Success)
+    {
+        if(status == ProcStatus::Timeout)
+            cerr << "Timeout after " << timeout << " sec: worker in " << _dir << endl;
+        else if(status == ProcStatus::Failure)
+            cerr << "Worker in " << _dir << " exited unexpectedly, see " << _dir << "/output_info.log" << endl;
+        _kill();
+        return status;
+    }
+
+    VectorXd result(num_spec);
+    stringstream ss(line);
+    for(size_t i = 0; i < num_spec; ++i)
+    {
+        if(not (ss >> result(i)))
+        {
+            // the worker may be out of sync with the parameters sent
+            cerr << "Invalid result from worker in " << _dir << ": " << line << endl;
+            _kill();
+            return ProcStatus::Failure;
+        }
+    }
+    y = result;
+    return ProcStatus::Success;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Process.h"
+#include <Eigen/Dense>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+// A long-lived evaluation process running in its own working directory.
+//
+// The worker is started once, the first line written to its stdin is the
+// names of the design variables, after that, each line written is one
+// parameter vector and the worker replies with one line of `num_spec` results
+//
+// Like `run_process`, the worker runs in its own process group, when it dies,
+// replies an invalid line, takes longer than `timeout` seconds (0 for no
+// limit) or the cancellation flag of the calling thread is raised, the whole
+// group is killed and a new worker is started for the next evaluation
+class Worker
+{
+public:
+    Worker(std::string dir, std::string script, const std::vector<std::string>& names);
+    ~Worker();
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    // the results are written to `y` on success
+    ProcStatus eval(const Eigen::VectorXd& x, size_t num_spec, double timeout, Eigen::VectorXd& y);
+
+private:
+    std::string              _dir;
+    std::string              _script;
+    std::vector<std::string> _names;
+    pid_t       _pid  = -1;
+    int         _to   = -1; // stdin of the worker
+    int         _from = -1; // stdout of the worker
+    std::string _buf;       // received, not yet a complete line
+
+    bool _start(); // false if the process can not be created
+    void _stop();
+    void _kill();
+    bool _send(const std::string& line);
+    ProcStatus _recv(std::string& line, double timeout);
+};
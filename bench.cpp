@@ -0,0 +1,286 @@
+// `mace_bench`: fixed-seed optimization campaigns on in-process test
+// functions, to time the optimizer itself and catch performance regressions
+#include "Benchmark.h"
+#include "MACE.h"
+#include "TaskPool.h"
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <omp.h>
+using namespace std;
+using namespace Eigen;
+typedef chrono::steady_clock Clock;
+
+struct BenchConf
+{
+    vector<string> funcs   = bench_func_names();
+    vector<size_t> dims    = {10};
+    vector<string> algos   = {"mace"};
+    vector<size_t> batches = {1, 4};
+    vector<size_t> threads = {1};
+    size_t max_eval        = 100;
+    size_t num_init        = 0; // 0 for dim + 1
+    size_t seed            = 1;
+    size_t repeat          = 1;
+    string csv             = "mace_bench.csv";
+};
+
+// Wall time spent in the objective: from the first call started to the last
+// call finished since the last `reset`, the evaluations of one batch run in
+// parallel
+class EvalTimer
+{
+public:
+    MACE::Obj wrap(MACE::Obj f)
+    {
+        return [this, f](const VectorXd& x) -> VectorXd {
+            const Clock::time_point t1 = Clock::now();
+            const VectorXd y           = f(x);
+            const Clock::time_point t2 = Clock::now();
+            lock_guard<mutex> lock(_mtx);
+            if(_num_calls == 0 or t1 < _first)
+                _first = t1;
+            if(_num_calls == 0 or t2 > _last)
+                _last = t2;
+            ++_num_calls;
+            ++_total_calls;
+            return y;
+        };
+    }
+    void reset()
+    {
+        lock_guard<mutex> lock(_mtx);
+        _num_calls = 0;
+    }
+    double wall() const
+    {
+        return _num_calls == 0 ? 0 : chrono::duration<double>(_last - _first).count();
+    }
+    size_t total_calls() const { return _total_calls; }
+
+private:
+    mutex             _mtx;
+    Clock::time_point _first;
+    Clock::time_point _last;
+    size_t            _num_calls   = 0;
+    size_t            _total_calls = 0;
+};
+
+struct CampaignResult
+{
+    double total_time = 0;
+    double model_time = 0;
+    double eval_time  = 0;
+    size_t num_iter   = 0;
+    double regret     = 0;
+    Profiler::Record profile; // summed over the iterations
+    CampaignResult()
+    {
+        profile.times.fill(0);
+        profile.counts.fill(0);
+    }
+};
+
+static CampaignResult run_campaign(const BenchFunc& bf, const string& algo, size_t batch, size_t num_thread,
+                                   size_t seed, const BenchConf& conf, ostream& csv)
+{
+    const size_t dim      = bf.lb.size();
+    const size_t num_init = conf.num_init == 0 ? dim + 1 : conf.num_init;
+    srand(seed);
+    omp_set_num_threads(batch);
+    TaskPool::instance().resize(num_thread);
+
+    EvalTimer timer;
+    stringstream log_name;
+    log_name << "mace_bench_" << bf.name << "_" << dim << "_" << algo << "_b" << batch << "_t" << num_thread << "_s" << seed << ".log";
+    MACE mace(timer.wrap(bf.f), 1, bf.lb, bf.ub, log_name.str());
+    mace.set_seed(seed);
+    mace.set_batch(batch);
+    mace.set_init_num(num_init);
+    mace.set_eval_fixed(conf.max_eval);
+    mace.set_force_select_hyp(true);
+    mace.set_gp_noise_lower_bound(1e-6);
+    mace.initialize(num_init);
+
+    // one iteration is run at a time by raising `max_eval` by one batch, so
+    // that each iteration is timed through the public interface
+    CampaignResult result;
+    while(timer.total_calls() < conf.max_eval)
+    {
+        mace.set_max_eval(timer.total_calls() + 1);
+        timer.reset();
+        const Clock::time_point t1 = Clock::now();
+        if(algo == "blcb")
+            mace.blcb();
+        else
+            mace.optimize();
+        const double t_iter = chrono::duration<double>(Clock::now() - t1).count();
+        const double t_eval = timer.wall();
+        const double best_y = mace.best_y()(0);
+        const Profiler::Record& prof = mace.last_profile();
+        result.total_time += t_iter;
+        result.eval_time  += t_eval;
+        result.model_time += t_iter - t_eval;
+        result.regret      = best_y - bf.opt;
+        ++result.num_iter;
+        csv << bf.name << "," << dim << "," << algo << "," << batch << "," << num_thread << "," << seed << ","
+            << result.num_iter << "," << timer.total_calls() << "," << t_iter << "," << t_iter - t_eval << ","
+            << t_eval << "," << best_y << "," << result.regret;
+        for(size_t i = 0; i < Profiler::NumPhases; ++i)
+        {
+            csv << "," << prof.times[i];
+            result.profile.times[i] += prof.times[i];
+        }
+        for(size_t i = 0; i < Profiler::NumCounters; ++i)
+        {
+            csv << "," << prof.counts[i];
+            result.profile.counts[i] += prof.counts[i];
+        }
+        csv << endl;
+    }
+    return result;
+}
+
+static vector<string> split(const string& str)
+{
+    vector<string> toks;
+    stringstream ss(str);
+    string tok;
+    while(getline(ss, tok, ','))
+        if(not tok.empty())
+            toks.push_back(tok);
+    return toks;
+}
+static vector<size_t> split_size(const string& str)
+{
+    vector<size_t> vals;
+    for(const string& tok : split(str))
+        vals.push_back(stoul(tok));
+    return vals;
+}
+static void usage()
+{
+    cerr << "Usage: mace_bench [options], lists are separated by commas\n"
+         << "    --func     names     test functions, default: branin,ackley,rosenbrock,hartmann6,alpine1\n"
+         << "    --dim      list      dimensions of ackley, rosenbrock and alpine1, default: 10\n"
+         << "    --algo     names     mace and/or blcb, default: mace\n"
+         << "    --batch    list      batch sizes, default: 1,4\n"
+         << "    --thread   list      threads of the model-side task pool, default: 1\n"
+         << "    --max_eval N         evaluations of each campaign, default: 100\n"
+         << "    --init     N         initial random samples, default: dim + 1\n"
+         << "    --seed     N         seed of the first repetition, default: 1\n"
+         << "    --repeat   N         repetitions with seeds seed, seed+1, ..., default: 1\n"
+         << "    --csv      path      per-iteration records, default: mace_bench.csv" << endl;
+}
+int main(int arg_num, char** args)
+{
+    BenchConf conf;
+    try
+    {
+        for(int i = 1; i < arg_num; i += 2)
+        {
+            const string opt = args[i];
+            if(i + 1 >= arg_num)
+                throw invalid_argument("Missing value of " + opt);
+            const string val = args[i + 1];
+            if(opt == "--func")
+                conf.funcs = split(val);
+            else if(opt == "--dim")
+                conf.dims = split_size(val);
+            else if(opt == "--algo")
+                conf.algos = split(val);
+            else if(opt == "--batch")
+                conf.batches = split_size(val);
+            else if(opt == "--thread")
+                conf.threads = split_size(val);
+            else if(opt == "--max_eval")
+                conf.max_eval = stoul(val);
+            else if(opt == "--init")
+                conf.num_init = stoul(val);
+            else if(opt == "--seed")
+                conf.seed = stoul(val);
+            else if(opt == "--repeat")
+                conf.repeat = stoul(val);
+            else if(opt == "--csv")
+                conf.csv = val;
+            else
+                throw invalid_argument("Unknown option " + opt);
+        }
+        for(const string& algo : conf.algos)
+            if(algo != "mace" and algo != "blcb")
+                throw invalid_argument("Unknown algo: " + algo);
+    }
+    catch(const exception& e)
+    {
+        cerr << e.what() << endl;
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    ofstream csv(conf.csv);
+    csv << setprecision(10);
+    csv << "func,dim,algo,batch,thread,seed,iter,evals,t_iter,t_model,t_eval,best_y,regret";
+    for(size_t i = 0; i < Profiler::NumPhases; ++i)
+        csv << ",time_" << Profiler::name(static_cast<Profiler::Phase>(i));
+    for(size_t i = 0; i < Profiler::NumCounters; ++i)
+        csv << ",count_" << Profiler::name(static_cast<Profiler::Counter>(i));
+    csv << endl;
+    cout << left << setw(12) << "func" << setw(5) << "dim" << setw(6) << "algo" << setw(7) << "batch" << setw(8)
+         << "thread" << setw(6) << "iter" << setw(12) << "total(s)" << setw(12) << "model(s)" << setw(14)
+         << "model/iter(s)" << setw(12) << "eval(s)" << "regret" << endl;
+    for(const string& name : conf.funcs)
+    {
+        const bool fixed_dim = name == "branin" or name == "hartmann6";
+        for(size_t d = 0; d < (fixed_dim ? 1 : conf.dims.size()); ++d)
+        {
+            BenchFunc bf;
+            try
+            {
+                bf = bench_func(name, conf.dims[d]);
+            }
+            catch(const exception& e)
+            {
+                cerr << e.what() << endl;
+                return EXIT_FAILURE;
+            }
+            for(const string& algo : conf.algos)
+            for(size_t batch : conf.batches)
+            for(size_t num_thread : conf.threads)
+            {
+                CampaignResult sum;
+                array<double, Profiler::NumCounters> counts; // averaged as doubles, counts below repeat are not lost
+                counts.fill(0);
+                for(size_t r = 0; r < conf.repeat; ++r)
+                {
+                    const CampaignResult result = run_campaign(bf, algo, batch, num_thread, conf.seed + r, conf, csv);
+                    sum.total_time += result.total_time / conf.repeat;
+                    sum.model_time += result.model_time / conf.repeat;
+                    sum.eval_time  += result.eval_time / conf.repeat;
+                    sum.regret     += result.regret / conf.repeat;
+                    sum.num_iter    = result.num_iter;
+                    for(size_t i = 0; i < Profiler::NumPhases; ++i)
+                        sum.profile.times[i] += result.profile.times[i] / conf.repeat;
+                    for(size_t i = 0; i < Profiler::NumCounters; ++i)
+                        counts[i] += static_cast<double>(result.profile.counts[i]) / conf.repeat;
+                }
+                cout << left << setw(12) << name << setw(5) << bf.lb.size() << setw(6) << algo << setw(7) << batch
+                     << setw(8) << num_thread << setw(6) << sum.num_iter << setw(12) << sum.total_time << setw(12)
+                     << sum.model_time << setw(14) << sum.model_time / sum.num_iter << setw(12) << sum.eval_time
+                     << sum.regret << endl;
+                cout << "    phases(s):";
+                for(size_t i = 0; i < Profiler::NumPhases; ++i)
+                    cout << " " << Profiler::name(static_cast<Profiler::Phase>(i)) << "=" << sum.profile.times[i];
+                cout << endl << "    counts:";
+                for(size_t i = 0; i < Profiler::NumCounters; ++i)
+                    cout << " " << Profiler::name(static_cast<Profiler::Counter>(i)) << "=" << counts[i];
+                cout << endl;
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,36 @@
+#!/usr/bin/perl
+# Batch version of run.pl, enabled by `option batch_eval 1`
+#
+# The first line of `param` is the names of the design variables, each
+# following line is one parameter vector, the objective values are written to
+# `result.po` as one line for each parameter vector, in the same order
+use strict;
+use warnings;
+use 5.010;
+
+open my $ifh, "<", "param" or die "Can't read param:$!\n";
+my $header = <$ifh>;
+die "No design variable names" if(not defined $header);
+chomp($header);
+my @names = split ' ', $header;
+
+open my $ofh, ">", "result.po" or die "Can't create result.po: $!\n";
+open my $rfh, ">>", "record" or die "Can't create record: $!\n";
+while(my $line = <$ifh>)
+{
+    chomp($line);
+    next if($line =~ /^\s*$/);
+    my %params;
+    @params{@names} = map { $_ + 0 } split ' ', $line;
+    die "x does not exist" if(not exists $params{x});
+    die "y does not exist" if(not exists $params{y});
+    my $x   = $params{x}-1;
+    my $y   = $params{y}-1;
+    my $fom = (1-$x)**2 + 100 * ($y - $x**2)**2;
+
+    say $ofh $fom;
+    say $rfh "$x $y $fom";
+}
+close $ifh;
+close $ofh;
+close $rfh;
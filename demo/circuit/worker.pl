@@ -0,0 +1,33 @@
+#!/usr/bin/perl
+# Persistent version of run.pl, enabled by `option persistent_worker 1`
+#
+# The first line read from STDIN is the names of the design variables, each
+# following line is one parameter vector, the objective value is written to
+# STDOUT as one line for each parameter vector
+use strict;
+use warnings;
+use 5.010;
+
+$| = 1;
+my $header = <STDIN>;
+die "No design variable names" if(not defined $header);
+chomp($header);
+my @names = split ' ', $header;
+
+while(my $line = <STDIN>)
+{
+    chomp($line);
+    my %params;
+    @params{@names} = map { $_ + 0 } split ' ', $line;
+    die "x does not exist" if(not exists $params{x});
+    die "y does not exist" if(not exists $params{y});
+    my $x   = $params{x}-1;
+    my $y   = $params{y}-1;
+    my $fom = (1-$x)**2 + 100 * ($y - $x**2)**2;
+
+    say $fom;
+
+    open my $rfh, ">>", "record" or die "Can't create record: $!\n";
+    say $rfh "$x $y $fom";
+    close $rfh;
+}
@@ -1,4 +1,5 @@
 #!/bin/bash
 rm -rvf *.log
+rm -rvf *.ckpt
 rm -rvf log err
 rm -rvf work/
@@ -0,0 +1,42 @@
+/* The objective of the demo as a plugin, build with
+ *
+ *     gcc -O2 -shared -fPIC -I/path/to/mace/include rosenbrock.c -o librosenbrock.so
+ *
+ * and run `mace_bo conf` in this directory */
+#include "mace_plugin.h"
+#include <stdlib.h>
+
+struct state
+{
+    size_t dim;
+    size_t num_spec;
+    double shift;
+};
+
+void* mace_plugin_init(size_t dim, size_t num_spec, const char* arg)
+{
+    struct state* s;
+    if(dim != 2 || num_spec != 1)
+        return NULL;
+    s           = malloc(sizeof(struct state));
+    s->dim      = dim;
+    s->num_spec = num_spec;
+    s->shift    = arg[0] == '\0' ? 1.0 : atof(arg);
+    return s;
+}
+int mace_plugin_eval(void* handle, size_t num, const double* xs, double* ys)
+{
+    const struct state* s = handle;
+    size_t i;
+    for(i = 0; i < num; ++i)
+    {
+        const double x = xs[i * s->dim] - s->shift;
+        const double y = xs[i * s->dim + 1] - s->shift;
+        ys[i * s->num_spec] = (1 - x) * (1 - x) + 100 * (y - x * x) * (y - x * x);
+    }
+    return 0;
+}
+void mace_plugin_teardown(void* handle)
+{
+    free(handle);
+}
@@ -0,0 +1,80 @@
+#include "mace_c.h"
+#include "MACE.h"
+#include <stdexcept>
+#include <string>
+using namespace std;
+using namespace Eigen;
+
+struct mace_opt
+{
+    MACE   mace;
+    size_t dim;
+    size_t num_spec;
+    string error;
+    mace_opt(size_t d, size_t n, const VectorXd& lb, const VectorXd& ub, string log_name)
+        : mace(n, lb, ub, log_name), dim(d), num_spec(n)
+    {
+        // the errors are returned to the caller, instead of exiting its
+        // program
+        mace.set_throw_on_error(true);
+    }
+};
+
+mace_opt* mace_create(size_t dim, size_t num_spec, const double* lb, const double* ub, const char* log_name)
+{
+    if(dim == 0 or num_spec == 0 or lb == nullptr or ub == nullptr)
+        return nullptr;
+    const VectorXd vlb = Map<const VectorXd>(lb, dim);
+    const VectorXd vub = Map<const VectorXd>(ub, dim);
+    if(not (vlb.array() < vub.array()).all())
+        return nullptr;
+    try
+    {
+        return new mace_opt(dim, num_spec, vlb, vub, log_name == nullptr ? "mace.log" : log_name);
+    }
+    catch(...)
+    {
+        return nullptr;
+    }
+}
+void mace_destroy(mace_opt* opt) { delete opt; }
+void mace_set_seed(mace_opt* opt, size_t seed) { opt->mace.set_seed(seed); }
+void mace_set_init_num(mace_opt* opt, size_t num) { opt->mace.set_init_num(num); }
+void mace_set_noise_free(mace_opt* opt, int flag) { opt->mace.set_noise_free(flag != 0); }
+void mace_set_checkpoint(mace_opt* opt, const char* path) { opt->mace.set_checkpoint(path == nullptr ? "" : path); }
+int mace_ask(mace_opt* opt, size_t num, double* xs)
+{
+    try
+    {
+        Map<MatrixXd>(xs, opt->dim, num) = opt->mace.ask(num);
+        return 0;
+    }
+    catch(const exception& e)
+    {
+        opt->error = e.what();
+        return -1;
+    }
+}
+int mace_tell(mace_opt* opt, size_t num, const double* xs, const double* ys)
+{
+    try
+    {
+        opt->mace.tell(Map<const MatrixXd>(xs, opt->dim, num), Map<const MatrixXd>(ys, opt->num_spec, num));
+        return 0;
+    }
+    catch(const exception& e)
+    {
+        opt->error = e.what();
+        return -1;
+    }
+}
+int mace_best(const mace_opt* opt, double* x, double* y)
+{
+    const VectorXd best_y = opt->mace.best_y();
+    if(not best_y.allFinite())
+        return -1; // nothing is told yet
+    Map<VectorXd>(x, opt->dim)      = opt->mace.best_x();
+    Map<VectorXd>(y, opt->num_spec) = best_y;
+    return 0;
+}
+const char* mace_error(const mace_opt* opt) { return opt->error.c_str(); }
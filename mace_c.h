@@ -0,0 +1,44 @@
+/* C interface of `libmace`, the ask/tell optimizer embedded in the caller's
+ * own job system: the caller asks for points, evaluates them however it
+ * likes, and tells the results back. Points are stored one after another,
+ * `dim` doubles for each point and `num_spec` doubles for each result, the
+ * same layout as `mace_plugin.h`. A handle must not be used by two threads at
+ * the same time. */
+#ifndef MACE_C_H
+#define MACE_C_H
+#include <stddef.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mace_opt mace_opt;
+
+/* `lb` and `ub` are `dim` doubles, the first spec is the objective and the
+ * others are constraints (feasible when <= 0), the log is written to
+ * `log_name`, returns NULL on failure */
+mace_opt* mace_create(size_t dim, size_t num_spec, const double* lb, const double* ub, const char* log_name);
+void mace_destroy(mace_opt* opt);
+
+/* configurations, set before the first `mace_ask` */
+void mace_set_seed(mace_opt* opt, size_t seed);
+void mace_set_init_num(mace_opt* opt, size_t num);
+void mace_set_noise_free(mace_opt* opt, int flag);
+void mace_set_checkpoint(mace_opt* opt, const char* path);
+
+/* Write `num` points to evaluate to the caller-provided `xs` of `dim * num`
+ * doubles, returns 0 on success */
+int mace_ask(mace_opt* opt, size_t num, double* xs);
+
+/* Tell the results `ys` of the `num` points `xs`, returns 0 on success */
+int mace_tell(mace_opt* opt, size_t num, const double* xs, const double* ys);
+
+/* The best point and its result found so far, returns 0 on success */
+int mace_best(const mace_opt* opt, double* x, double* y);
+
+/* Message of the last failed call on `opt` */
+const char* mace_error(const mace_opt* opt);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,31 @@
+/* C ABI of the objective plugins loaded by `mace_bo`, with the line
+ *
+ *     plugin /path/to/libobj.so [argument]
+ *
+ * in the configuration file. The plugin is a shared library exporting the
+ * three functions below, `mace_bo` calls them from its evaluation threads,
+ * each thread creates its own handle with `mace_plugin_init`, so a handle is
+ * never used by two threads at the same time. With `option batch_eval 1`,
+ * all the points of a batch are passed to one `mace_plugin_eval` call. */
+#ifndef MACE_PLUGIN_H
+#define MACE_PLUGIN_H
+#include <stddef.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* `arg` is the rest of the `plugin` line after the path, an empty string if
+ * there is none, returns NULL on failure */
+void* mace_plugin_init(size_t dim, size_t num_spec, const char* arg);
+
+/* Evaluate `num` points, `xs` is `dim * num` doubles with the points one after
+ * another, the results are written to the caller-provided `ys` of
+ * `num_spec * num` doubles in the same order, returns 0 on success */
+int mace_plugin_eval(void* handle, size_t num, const double* xs, double* ys);
+
+void mace_plugin_teardown(void* handle);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
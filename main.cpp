@@ -3,6 +3,7 @@
 #include "MACE.h"
 #include "MACE_util.h"
 #include "NLopt_wrapper.h"
+#include "TaskPool.h"
 #include <iostream>
 #include <boost/optional/optional_io.hpp>
 #include <omp.h>
@@ -13,11 +14,12 @@ int main(int arg_num, char** args)
     // srand(rand_seed);
     srand(random_device{}());
 
-    if(arg_num < 2)
+    if(arg_num < 2 or (arg_num > 2 and string(args[2]) != "--resume"))
     {
-        cerr << "Usage: mobo_wapi path/to/conf/file" << endl;
+        cerr << "Usage: mobo_wapi path/to/conf/file [--resume]" << endl;
         return EXIT_FAILURE;
     }
+    const bool resume = arg_num > 2;
 #ifdef MYDEBUG
     run_cmd("rm -rvf work");
 #endif
@@ -26,6 +28,7 @@ int main(int arg_num, char** args)
 
     Config conf(conf_file);
     conf.parse();
+    conf.set_resume(resume);
     conf.print();
 
     size_t num_spec   = 0;
@@ -60,7 +63,20 @@ int main(int arg_num, char** args)
     const double EI_jitter          = conf.lookup("EI_jitter").value_or(0.0);
     const double eps                = conf.lookup("eps").value_or(1e-3);
     const bool   force_select_hyp   = conf.lookup("force_select_hyp").value_or(true);
+    const size_t hyp_starts         = conf.lookup("hyp_starts").value_or(4);
+    const bool   sparse_gp          = conf.lookup("sparse_gp").value_or(false);
+    const size_t sparse_threshold   = conf.lookup("sparse_threshold").value_or(1000);
+    const size_t num_inducing       = conf.lookup("num_inducing").value_or(500);
     const bool   posterior_ref      = conf.lookup("posterior_ref").value_or(false);
+    const bool   checkpoint         = conf.lookup("checkpoint").value_or(true);
+    const bool   profile            = conf.lookup("profile").value_or(false);
+    const bool   log_async          = conf.lookup("log_async").value_or(false);
+    const size_t log_level          = conf.lookup("log_level").value_or(boost::log::trivial::info);
+    const bool   trace              = conf.lookup("trace").value_or(false);
+    const size_t init_max           = conf.lookup("init_max").value_or(0);
+    const size_t model_thread       = conf.lookup("model_thread").value_or(0);
+    const bool   batch_eval         = conf.lookup("batch_eval").value_or(false);
+    const double speculate          = conf.lookup("speculate").value_or(0);
     const string algo               = conf.algo();
     MACE::SelectStrategy ss;
     switch(selection_strategy)
@@ -79,19 +95,29 @@ int main(int arg_num, char** args)
             exit(EXIT_FAILURE);
     }
 
+    // `num_thread` evaluations run in parallel, the model-side computation
+    // runs in a separate pool of `model_thread` threads, 0 for all the cores
     omp_set_num_threads(num_thread);
+    TaskPool::instance().resize(model_thread);
 
-    MACE::Obj obj = conf.gen_obj();
-
-    MACE mace(obj, num_spec, conf.lb(), conf.ub());
+    MACE mace(batch_eval ? MACE::Obj() : conf.gen_obj(), num_spec, conf.lb(), conf.ub());
+    if(batch_eval)
+        mace.set_batch_func(conf.gen_batch_obj());
     // Optional algorithm settings
     mace.set_tol_no_improvement(tol_no_improvement);
     mace.set_eval_fixed(eval_fixed);
     mace.set_max_eval(max_eval);
     mace.set_init_num(num_init);
     mace.set_batch(num_thread);
+    // a plugin evaluates in-process and can not be cancelled, a duplicate
+    // would only hold an idle thread until the original finishes
+    if(speculate > 0 and conf.use_plugin())
+        cerr << "option speculate is ignored with an objective plugin" << endl;
+    mace.set_speculation(conf.use_plugin() ? 0 : speculate);
     mace.set_mo_record(mo_record);
     mace.set_force_select_hyp(force_select_hyp);
+    mace.set_hyp_starts(hyp_starts);
+    mace.set_sparse_gp(sparse_gp, sparse_threshold, num_inducing);
     mace.set_posterior_ref(posterior_ref);
     mace.set_mo_f(mo_f);
     mace.set_mo_cr(mo_cr);
@@ -106,9 +132,24 @@ int main(int arg_num, char** args)
     if(not noise_free)
         mace.set_gp_noise_lower_bound(noise_lb);
     mace.set_noise_free(noise_free);
-    mace.initialize(num_init);
+    if(checkpoint or resume)
+        mace.set_checkpoint("mace.ckpt");
+    if(profile)
+        mace.set_profile("mace_profile.jsonl");
+    mace.set_log_async(log_async);
+    mace.set_log_level(static_cast<boost::log::trivial::severity_level>(std::min<size_t>(log_level, boost::log::trivial::fatal)));
+    if(trace)
+        mace.set_trace("mace.trace");
+    if(resume)
+        mace.resume("mace.ckpt");
+    else if(not conf.init_db().empty())
+        mace.initialize_binary(conf.init_db(), init_max);
+    else
+        mace.initialize(num_init);
     if(algo == "mace")
         mace.optimize();
+    else if(algo == "mace_async")
+        mace.optimize_async();
     else if(algo == "blcb")
         mace.blcb();
     else 
@@ -0,0 +1,220 @@
+// `mace_server`: a local daemon hosting many studies in one process, driven
+// by the ask/tell requests of the clients on a Unix socket, see
+// `StudyServer.h` for the protocol
+#include "StudyServer.h"
+#include "Logging.h"
+#include "TaskPool.h"
+#include <atomic>
+#include <boost/log/utility/setup/common_attributes.hpp>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <omp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+struct ServerConf
+{
+    string socket  = "mace.sock";
+    string log_dir = ".";
+    size_t runners = 2; // requests of different studies run at the same time
+    size_t threads = 0; // threads of the shared task pool, 0 for all the cores
+    size_t max_clients = 64;
+};
+
+// a thread serving one connection, joined once `done` is set, or when the
+// server stops
+struct Client
+{
+    int fd;
+    thread t;
+    shared_ptr<atomic<bool>> done;
+};
+
+static volatile sig_atomic_t stop_flag = 0;
+static void on_stop(int) { stop_flag = 1; }
+
+// one line for each request and each reply, the connection is closed by the
+// caller once `done` is set
+static void serve_client(StudyServer& server, int fd, shared_ptr<atomic<bool>> done)
+{
+    string buf;
+    char   chunk[4096];
+    bool   connected = true;
+    while(connected)
+    {
+        const ssize_t n = read(fd, chunk, sizeof(chunk));
+        if(n <= 0)
+            break;
+        buf.append(chunk, n);
+        size_t pos;
+        while(connected and (pos = buf.find('\n')) != string::npos)
+        {
+            const string reply = server.handle(buf.substr(0, pos)) + "\n";
+            buf.erase(0, pos + 1);
+            size_t written = 0;
+            while(connected and written < reply.size())
+            {
+                const ssize_t w = write(fd, reply.data() + written, reply.size() - written);
+                if(w <= 0)
+                    connected = false;
+                else
+                    written += w;
+            }
+        }
+    }
+    *done = true;
+}
+static void reap_clients(list<Client>& clients)
+{
+    for(auto it = clients.begin(); it != clients.end();)
+    {
+        if(*it->done)
+        {
+            it->t.join();
+            close(it->fd);
+            it = clients.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+static void usage()
+{
+    cerr << "Usage: mace_server [options]\n"
+         << "    --socket  path      Unix socket to listen on, default: mace.sock\n"
+         << "    --log_dir path      directory of the logs of the studies, default: .\n"
+         << "    --runners N         requests of different studies run at the same time, default: 2\n"
+         << "    --threads N         threads of the shared model-side task pool, default: 0 for all the cores\n"
+         << "    --max_clients N     connections served at the same time, default: 64" << endl;
+}
+int main(int arg_num, char** args)
+{
+    ServerConf conf;
+    try
+    {
+        for(int i = 1; i < arg_num; i += 2)
+        {
+            const string opt = args[i];
+            if(i + 1 >= arg_num)
+                throw invalid_argument("Missing value of " + opt);
+            const string val = args[i + 1];
+            if(opt == "--socket")
+                conf.socket = val;
+            else if(opt == "--log_dir")
+                conf.log_dir = val;
+            else if(opt == "--runners")
+                conf.runners = stoul(val);
+            else if(opt == "--threads")
+                conf.threads = stoul(val);
+            else if(opt == "--max_clients")
+                conf.max_clients = stoul(val);
+            else
+                throw invalid_argument("Unknown option " + opt);
+        }
+    }
+    catch(const exception& e)
+    {
+        cerr << e.what() << endl;
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(conf.socket.size() >= sizeof(addr.sun_path))
+    {
+        cerr << "Socket path is too long: " << conf.socket << endl;
+        return EXIT_FAILURE;
+    }
+    strncpy(addr.sun_path, conf.socket.c_str(), sizeof(addr.sun_path) - 1);
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(conf.socket.c_str());
+    if(listen_fd < 0 or bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 or listen(listen_fd, 64) != 0)
+    {
+        cerr << "Fail to listen on " << conf.socket << ": " << strerror(errno) << endl;
+        return EXIT_FAILURE;
+    }
+
+    // a client leaving without reading its reply should not kill the server
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    // all the model-side computation of the studies shares one pool, OpenMP
+    // is only used to run the evaluations, which the clients do themselves
+    omp_set_num_threads(1);
+    TaskPool::instance().resize(conf.threads);
+    boost::log::add_common_attributes();
+    LogSink log(conf.log_dir + "/mace_server.log", true); // records not tagged with a study
+    StudyServer server(conf.runners, conf.log_dir);
+    cout << "mace_server listening on " << conf.socket << endl;
+    list<Client> clients;
+    int ret = EXIT_SUCCESS;
+    while(not stop_flag)
+    {
+        // polled with a timeout, so that the finished clients are joined and
+        // the stop signal is noticed without a new connection
+        pollfd pfd{listen_fd, POLLIN, 0};
+        const int ready = poll(&pfd, 1, 200);
+        reap_clients(clients);
+        if(ready <= 0)
+        {
+            if(ready < 0 and errno != EINTR)
+            {
+                cerr << "Fail to poll: " << strerror(errno) << endl;
+                ret = EXIT_FAILURE;
+                break;
+            }
+            continue;
+        }
+        const int fd = accept(listen_fd, nullptr, nullptr);
+        if(fd < 0)
+        {
+            if(errno == EINTR or errno == ECONNABORTED)
+                continue;
+            cerr << "Fail to accept: " << strerror(errno) << endl;
+            ret = EXIT_FAILURE;
+            break;
+        }
+        if(clients.size() >= conf.max_clients)
+        {
+            const string reply = "error Too many clients\n";
+            if(write(fd, reply.data(), reply.size()) < 0)
+            {
+                // the client is rejected anyway
+            }
+            close(fd);
+            continue;
+        }
+        shared_ptr<atomic<bool>> done = make_shared<atomic<bool>>(false);
+        clients.push_back(Client{fd, thread(serve_client, ref(server), fd, done), done});
+    }
+
+    // the connections are shut down for reading to wake up the blocked reads,
+    // a client waiting for its request still gets the reply
+    close(listen_fd);
+    unlink(conf.socket.c_str());
+    for(Client& c : clients)
+        shutdown(c.fd, SHUT_RD);
+    for(Client& c : clients)
+    {
+        c.t.join();
+        close(c.fd);
+    }
+    cout << "mace_server stopped" << endl;
+    return ret;
+}
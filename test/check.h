@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdlib>
+#include <iostream>
+// `assert` is compiled out in release builds, the tests check with this
+// instead, the test stops at the first failed check
+#define CHECK(cond)                                                                               \
+    do                                                                                            \
+    {                                                                                             \
+        if(not(cond))                                                                             \
+        {                                                                                         \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #cond << std::endl; \
+            std::exit(EXIT_FAILURE);                                                              \
+        }                                                                                         \
+    } while(0)
+
+// the expression throws an exception of type `E`
+#define CHECK_THROW(expr, E)      \
+    do                            \
+    {                             \
+        bool thrown = false;      \
+        try                       \
+        {                         \
+            expr;                 \
+        }                         \
+        catch(const E&)           \
+        {                         \
+            thrown = true;        \
+        }                         \
+        CHECK(thrown);            \
+    } while(0)
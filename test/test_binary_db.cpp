@@ -0,0 +1,86 @@
+#include "BinaryDB.h"
+#include "check.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+using namespace std;
+using namespace Eigen;
+
+// a database with the given header, followed by `num_values` doubles
+static void write_raw(const string& path, uint64_t dim, uint64_t num_spec, uint64_t size, size_t num_values)
+{
+    const uint64_t header[3] = {dim, num_spec, size};
+    const vector<double> values(num_values, 1.0);
+    ofstream out(path, ios::binary);
+    out.write("MACEDB1\n", 8);
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(values.data()), sizeof(double) * values.size());
+}
+int main()
+{
+    const string path  = "test_binary_db.db";
+    const MatrixXd dbx = MatrixXd::Random(4, 50);
+    const MatrixXd dby = MatrixXd::Random(2, 50);
+    BinaryDB::write(path, dbx, dby);
+    {
+        BinaryDB db(path);
+        CHECK(db.dim() == 4);
+        CHECK(db.num_spec() == 2);
+        CHECK(db.size() == 50);
+        for(size_t i = 0; i < db.size(); ++i)
+        {
+            CHECK(Map<const VectorXd>(db.x(i), 4) == dbx.col(i));
+            CHECK(Map<const VectorXd>(db.y(i), 2) == dby.col(i));
+        }
+    }
+    CHECK_THROW(BinaryDB::write(path, dbx, dby.leftCols(10)), runtime_error);
+
+    // truncated database
+    {
+        ifstream in(path, ios::binary);
+        string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        ofstream out(path, ios::binary);
+        out.write(bytes.data(), bytes.size() - 8);
+    }
+    CHECK_THROW(BinaryDB db(path), runtime_error);
+
+    // corrupt headers
+    write_raw(path, 2, 1, 4, 12);
+    {
+        BinaryDB db(path);
+        CHECK(db.size() == 4);
+    }
+    write_raw(path, 0, 1, 4, 12);
+    CHECK_THROW(BinaryDB db(path), runtime_error); // no x
+    write_raw(path, 2, 0, 4, 12);
+    CHECK_THROW(BinaryDB db(path), runtime_error); // no y
+    write_raw(path, 0, 0, 0, 0);
+    CHECK_THROW(BinaryDB db(path), runtime_error);
+    write_raw(path, uint64_t(1) << 62, uint64_t(1) << 62, 1, 12);
+    CHECK_THROW(BinaryDB db(path), runtime_error); // the record size overflows to 0
+    write_raw(path, UINT64_MAX, 1, 1, 12);
+    CHECK_THROW(BinaryDB db(path), runtime_error);
+    write_raw(path, 2, 1, 5, 12);
+    CHECK_THROW(BinaryDB db(path), runtime_error); // fewer records than the header says
+    write_raw(path, 2, 1, 3, 12);
+    CHECK_THROW(BinaryDB db(path), runtime_error); // more records than the header says
+    write_raw(path, 2, 1, 4, 13);
+    CHECK_THROW(BinaryDB db(path), runtime_error); // a partial record
+    write_raw(path, 2, 1, 0, 0);
+    {
+        BinaryDB db(path);
+        CHECK(db.size() == 0);
+    }
+
+    // not a database
+    {
+        ofstream out(path, ios::binary);
+        out << "this is not a MACE database at all";
+    }
+    CHECK_THROW(BinaryDB db(path), runtime_error);
+    remove(path.c_str());
+    CHECK_THROW(BinaryDB db(path), runtime_error);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+/* The C interface of `libmace`, minimizing a shifted sphere by ask/tell */
+#include "mace_c.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(cond)                                                                   \
+    do                                                                                \
+    {                                                                                 \
+        if(!(cond))                                                                   \
+        {                                                                             \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                       \
+        }                                                                             \
+    } while(0)
+
+static double sphere(const double* x)
+{
+    return (x[0] - 1) * (x[0] - 1) + (x[1] + 2) * (x[1] + 2);
+}
+int main(void)
+{
+    const double lb[2] = {-5, -5};
+    const double ub[2] = {5, 5};
+    double xs[2 * 4];
+    double ys[4];
+    double best_x[2];
+    double best_y;
+    double bad_x[2] = {10, 0};
+    double first_y  = 0;
+    size_t iter;
+    size_t i;
+    mace_opt* opt;
+
+    CHECK(mace_create(2, 1, ub, lb, "test_c_api.log") == NULL);
+    CHECK(mace_create(0, 1, lb, ub, "test_c_api.log") == NULL);
+    opt = mace_create(2, 1, lb, ub, "test_c_api.log");
+    CHECK(opt != NULL);
+    mace_set_seed(opt, 1);
+    mace_set_init_num(opt, 4);
+    CHECK(mace_best(opt, best_x, &best_y) != 0); /* nothing told yet */
+
+    for(iter = 0; iter < 6; ++iter)
+    {
+        const size_t num = iter == 0 ? 4 : 1;
+        CHECK(mace_ask(opt, num, xs) == 0);
+        for(i = 0; i < num; ++i)
+        {
+            CHECK(xs[2 * i] >= lb[0] && xs[2 * i] <= ub[0]);
+            CHECK(xs[2 * i + 1] >= lb[1] && xs[2 * i + 1] <= ub[1]);
+            ys[i] = sphere(xs + 2 * i);
+        }
+        CHECK(mace_tell(opt, num, xs, ys) == 0);
+        if(iter == 0)
+            first_y = ys[0];
+    }
+    CHECK(mace_best(opt, best_x, &best_y) == 0);
+    CHECK(fabs(best_y - sphere(best_x)) < 1e-12);
+    CHECK(best_y <= first_y);
+
+    /* invalid data is reported, not fatal */
+    CHECK(mace_tell(opt, 1, bad_x, ys) != 0);
+    CHECK(mace_error(opt)[0] != '\0');
+    mace_destroy(opt);
+    return EXIT_SUCCESS;
+}
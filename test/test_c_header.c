@@ -0,0 +1,10 @@
+/* The public headers are valid C */
+#include "mace_c.h"
+#include "mace_plugin.h"
+#include <stdlib.h>
+
+int main(void)
+{
+    mace_opt* opt = NULL;
+    return opt == NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+}
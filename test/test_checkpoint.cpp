@@ -0,0 +1,67 @@
+#include "Checkpoint.h"
+#include "check.h"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+using namespace std;
+using namespace Eigen;
+
+static bool exists(const string& path)
+{
+    return ifstream(path).good();
+}
+int main()
+{
+    const string path = "test_checkpoint.bin";
+    remove(path.c_str());
+    const MatrixXd m   = MatrixXd::Random(3, 5);
+    const MatrixXd empty(4, 0);
+    {
+        CheckpointWriter writer(path);
+        writer.write(static_cast<size_t>(42));
+        writer.write(3.25);
+        writer.write(string("MACE checkpoint"));
+        writer.write(string(""));
+        writer.write(m);
+        writer.write(empty);
+        CHECK(not exists(path)); // only visible after `commit`
+        writer.commit();
+    }
+    CHECK(exists(path));
+    CHECK(not exists(path + ".tmp"));
+    {
+        CheckpointReader reader(path);
+        CHECK(reader.read_size() == 42);
+        CHECK(reader.read_double() == 3.25);
+        CHECK(reader.read_string() == "MACE checkpoint");
+        CHECK(reader.read_string().empty());
+        CHECK(reader.read_matrix() == m);
+        const MatrixXd e = reader.read_matrix();
+        CHECK(e.rows() == 4 and e.cols() == 0);
+        CHECK_THROW(reader.read_size(), runtime_error); // past the end
+    }
+
+    // a writer destroyed without `commit` keeps the previous checkpoint
+    {
+        CheckpointWriter writer(path);
+        writer.write(static_cast<size_t>(7));
+    }
+    CHECK(not exists(path + ".tmp"));
+    {
+        CheckpointReader reader(path);
+        CHECK(reader.read_size() == 42);
+    }
+
+    // a truncated file is detected
+    {
+        ofstream f(path, ios::binary);
+        f.write("abc", 3);
+    }
+    {
+        CheckpointReader reader(path);
+        CHECK_THROW(reader.read_size(), runtime_error);
+    }
+    remove(path.c_str());
+    CHECK_THROW(CheckpointReader reader(path), runtime_error);
+    return EXIT_SUCCESS;
+}
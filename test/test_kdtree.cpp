@@ -0,0 +1,49 @@
+#include "KDTree.h"
+#include "check.h"
+#include <random>
+using namespace std;
+using namespace Eigen;
+
+static bool brute_force(const MatrixXd& pts, const VectorXd& x, double radius)
+{
+    for(long i = 0; i < pts.cols(); ++i)
+        if((pts.col(i) - x).norm() < radius)
+            return true;
+    return false;
+}
+int main()
+{
+    mt19937_64 engine(1);
+    uniform_real_distribution<double> unif(-1, 1);
+    const size_t dim = 3;
+    MatrixXd pts(dim, 200);
+    for(long i = 0; i < pts.size(); ++i)
+        pts(i) = unif(engine);
+
+    KDTree empty(dim);
+    CHECK(empty.size() == 0);
+    CHECK(not empty.has_neighbor(VectorXd::Zero(dim), 10));
+
+    // the first half builds the tree, the rest are inserted at the leaves
+    KDTree tree(dim);
+    tree.build(pts.leftCols(100));
+    for(long i = 100; i < pts.cols(); ++i)
+        tree.insert(pts.col(i));
+    CHECK(tree.size() == 200);
+    for(size_t q = 0; q < 2000; ++q)
+    {
+        VectorXd x(dim);
+        for(size_t j = 0; j < dim; ++j)
+            x(j) = unif(engine);
+        const double radius = 0.02 + 0.2 * (q % 5);
+        CHECK(tree.has_neighbor(x, radius) == brute_force(pts, x, radius));
+    }
+    for(long i = 0; i < pts.cols(); ++i)
+        CHECK(tree.has_neighbor(pts.col(i), 1e-9));
+
+    // `build` replaces the indexed points
+    tree.build(pts.leftCols(1));
+    CHECK(tree.size() == 1);
+    CHECK(not tree.has_neighbor(pts.col(1), 1e-9) or (pts.col(1) - pts.col(0)).norm() < 1e-9);
+    return EXIT_SUCCESS;
+}
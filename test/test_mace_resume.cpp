@@ -0,0 +1,72 @@
+// The checkpoint of a sparse-mode MACE keeps the subset of the GP, so that
+// the resumed run builds its GP on the same points instead of all of them
+#include "MACE.h"
+#include "check.h"
+#include <cstdio>
+#include <vector>
+using namespace std;
+using namespace Eigen;
+
+// exposes the GP and its subset
+class SparseMACE : public MACE
+{
+public:
+    using MACE::MACE;
+    const vector<size_t>& gp_idx() const { return _gp_idx; }
+    long gp_size() const { return _gp->train_in().cols(); }
+};
+static MatrixXd sphere(const MatrixXd& xs)
+{
+    return xs.colwise().squaredNorm();
+}
+int main()
+{
+    const string path = "test_mace_resume.ckpt";
+    const VectorXd lb = VectorXd::Constant(2, -1);
+    const VectorXd ub = VectorXd::Constant(2, 1);
+    srand(1);
+    const MatrixXd xs = MatrixXd::Random(2, 60);
+    vector<size_t> saved_idx;
+    {
+        SparseMACE mace(1, lb, ub, "test_mace_resume.log");
+        mace.set_sparse_gp(true, 40, 30);
+        mace.initialize(xs.leftCols(30), sphere(xs.leftCols(30)));
+        CHECK(mace.gp_idx().empty());
+        CHECK(mace.gp_size() == 30);
+
+        // the subset is selected once there are more than 40 points, and
+        // then updated with the new points
+        mace.tell(xs.middleCols(30, 20), sphere(xs.middleCols(30, 20)));
+        CHECK(mace.gp_idx().size() == 30);
+        mace.tell(xs.rightCols(10), sphere(xs.rightCols(10)));
+        CHECK(mace.gp_idx().size() == 30);
+        CHECK(mace.gp_size() == 30);
+        saved_idx = mace.gp_idx();
+        mace.save_checkpoint(path);
+    }
+    {
+        SparseMACE mace(1, lb, ub, "test_mace_resume.log");
+        mace.set_sparse_gp(true, 40, 30);
+        mace.resume(path);
+        CHECK(mace.gp_idx() == saved_idx);
+        CHECK(mace.gp_size() == 30);
+    }
+
+    // a run whose GP uses all the points is resumed without a subset, even
+    // above the threshold
+    {
+        SparseMACE mace(1, lb, ub, "test_mace_resume.log");
+        mace.set_sparse_gp(true, 40, 30);
+        mace.initialize(xs, sphere(xs));
+        mace.save_checkpoint(path);
+    }
+    {
+        SparseMACE mace(1, lb, ub, "test_mace_resume.log");
+        mace.set_sparse_gp(true, 40, 30);
+        mace.resume(path);
+        CHECK(mace.gp_idx().empty());
+        CHECK(mace.gp_size() == 60);
+    }
+    remove(path.c_str());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#include "MACE_util.h"
+#include "check.h"
+#include <cmath>
+#include <limits>
+using namespace std;
+using namespace Eigen;
+
+// scalar references from the C library
+static double ref_normcdf(double x) { return 0.5 * erfc(-x * M_SQRT1_2); }
+static double ref_normpdf(double x) { return exp(-0.5 * x * x) / sqrt(2 * M_PI); }
+static double ref_logphi(double x)
+{
+    if(x > -30)
+        return x > 0 ? log1p(-0.5 * erfc(x * M_SQRT1_2)) : log(0.5 * erfc(-x * M_SQRT1_2));
+    // erfc underflows, asymptotic expansion of the tail
+    const double r = 1 / (x * x);
+    return -0.5 * x * x - log(-x) - 0.5 * log(2 * M_PI) + log(1 - r * (1 - 3 * r * (1 - 5 * r * (1 - 7 * r))));
+}
+static bool close(double v, double ref, double tol)
+{
+    if(ref == 0 or fabs(ref) < numeric_limits<double>::min())
+        return fabs(v) < 1e3 * numeric_limits<double>::min(); // both underflow
+    return fabs(v - ref) <= tol * fabs(ref);
+}
+int main()
+{
+    // the tails up to |x| = 40, where normcdf and normpdf underflow
+    const ArrayXd xs  = ArrayXd::LinSpaced(8001, -40, 40);
+    const ArrayXd cdf = normcdf(xs);
+    const ArrayXd pdf = normpdf(xs);
+    const ArrayXd lp  = logphi(xs);
+    for(long i = 0; i < xs.size(); ++i)
+    {
+        // the error of the log-domain tail grows with x^2
+        const double x   = xs(i);
+        const double tol = fabs(x) <= 30 ? 2e-13 : 5e-13;
+        CHECK(close(cdf(i), ref_normcdf(x), tol));
+        CHECK(close(pdf(i), ref_normpdf(x), 1e-15));
+        CHECK(close(lp(i), ref_logphi(x), tol));
+        CHECK(std::isfinite(lp(i)));
+    }
+    CHECK(normcdf(ArrayXd::Constant(1, 0))(0) == 0.5);
+    CHECK(logphi(ArrayXd::Constant(1, -1e3))(0) < -5e5);
+
+    // min_sq_dist against a brute-force search, with more points in ref than
+    // one block
+    const MatrixXd ref = MatrixXd::Random(3, 600);
+    const MatrixXd pts = MatrixXd::Random(3, 40);
+    const VectorXd dist = min_sq_dist(ref, pts);
+    CHECK(dist.size() == 40);
+    for(long i = 0; i < pts.cols(); ++i)
+    {
+        const double brute = (ref.colwise() - pts.col(i)).colwise().squaredNorm().minCoeff();
+        CHECK(fabs(dist(i) - brute) < 1e-12);
+    }
+    CHECK(min_sq_dist(ref, ref.leftCols(5)).maxCoeff() < 1e-12);      // points of ref are at distance 0
+    CHECK((min_sq_dist(ref, ref.leftCols(5)).array() >= 0).all());    // not negative by rounding
+    CHECK(std::isinf(min_sq_dist(MatrixXd(3, 0), pts).minCoeff())); // empty ref
+    CHECK(min_sq_dist(ref, MatrixXd(3, 0)).size() == 0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,46 @@
+#include "Plugin.h"
+#include "check.h"
+#include <cmath>
+#include <stdexcept>
+using namespace std;
+using namespace Eigen;
+
+// the demo plugin `demo/plugin/rosenbrock.c`, whose path is the argument
+int main(int arg_num, char** args)
+{
+    CHECK(arg_num == 2);
+    const string path = args[1];
+    {
+        Plugin plugin(path, "", 2, 1, 2);
+        CHECK(plugin.num_spec() == 1);
+        MatrixXd xs(2, 3);
+        xs << 2, 1, 3,
+              2, 0, 1;
+        for(size_t tid = 0; tid < 2; ++tid)
+        {
+            const MatrixXd ys = plugin.eval(tid, xs);
+            CHECK(ys.rows() == 1 and ys.cols() == 3);
+            for(long i = 0; i < xs.cols(); ++i)
+            {
+                const double x = xs(0, i) - 1;
+                const double y = xs(1, i) - 1;
+                CHECK(fabs(ys(0, i) - ((1 - x) * (1 - x) + 100 * (y - x * x) * (y - x * x))) < 1e-12);
+            }
+        }
+        CHECK(plugin.eval(0, xs.leftCols(1))(0, 0) == 0); // the optimum, shifted by 1
+        CHECK_THROW(plugin.eval(2, xs), runtime_error);
+        CHECK_THROW(plugin.eval(0, MatrixXd::Zero(3, 1)), runtime_error);
+    }
+    {
+        // the argument is passed to `mace_plugin_init`
+        Plugin plugin(path, "0", 2, 1, 1);
+        CHECK(plugin.eval(0, MatrixXd::Ones(2, 1))(0, 0) == 0);
+    }
+    {
+        // the plugin rejects the dimension in `mace_plugin_init`
+        Plugin plugin(path, "", 3, 1, 1);
+        CHECK_THROW(plugin.eval(0, MatrixXd::Zero(3, 1)), runtime_error);
+    }
+    CHECK_THROW(Plugin("no_such_plugin_of_mace.so", "", 2, 1, 1), runtime_error);
+    return EXIT_SUCCESS;
+}
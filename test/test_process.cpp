@@ -0,0 +1,73 @@
+#include "Process.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+using namespace std;
+typedef chrono::steady_clock Clock;
+
+static double since(Clock::time_point t)
+{
+    return chrono::duration<double>(Clock::now() - t).count();
+}
+// the process is gone, or is a zombie not reaped by its new parent
+static bool is_dead(long pid)
+{
+    ifstream stat("/proc/" + to_string(pid) + "/stat");
+    string comm, state;
+    long p;
+    return not(stat >> p >> comm >> state) or state == "Z";
+}
+static bool wait_dead(long pid)
+{
+    const Clock::time_point t1 = Clock::now();
+    while(since(t1) < 2)
+    {
+        if(is_dead(pid))
+            return true;
+        this_thread::sleep_for(chrono::milliseconds(20));
+    }
+    return false;
+}
+int main()
+{
+    CHECK(run_process("true", 0) == ProcStatus::Success);
+    CHECK(run_process("exit 3", 0) == ProcStatus::Failure);
+    CHECK(run_process("no_such_command_of_mace 2>/dev/null", 0) == ProcStatus::Failure);
+
+    // the whole process group is killed on timeout, including the commands
+    // started in background by the script
+    const string pid_file = "test_process.pid";
+    remove(pid_file.c_str());
+    Clock::time_point t1 = Clock::now();
+    CHECK(run_process("sleep 30 & echo $! > " + pid_file + "; wait", 0.3) == ProcStatus::Timeout);
+    CHECK(since(t1) < 5);
+    long pid = 0;
+    CHECK(ifstream(pid_file) >> pid);
+    CHECK(wait_dead(pid));
+    remove(pid_file.c_str());
+
+    // cancelled by the flag of the calling thread
+    atomic<bool> cancel(false);
+    thread canceller([&]() {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        cancel = true;
+    });
+    t1 = Clock::now();
+    {
+        EvalCancelScope scope(&cancel);
+        CHECK(eval_cancel_flag() == &cancel);
+        CHECK(run_process("sleep 30", 0) == ProcStatus::Cancelled);
+    }
+    CHECK(eval_cancel_flag() == nullptr);
+    CHECK(since(t1) < 5);
+    canceller.join();
+
+    // a raised flag does not affect the other threads
+    thread other([]() { CHECK(run_process("true", 0) == ProcStatus::Success); });
+    other.join();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#include "TaskPool.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+using namespace std;
+
+int main()
+{
+    TaskPool::instance().resize(4);
+    CHECK(TaskPool::instance().num_threads() == 4);
+
+    // nested submissions from more threads outside the pool than it has
+    // external deques
+    atomic<long> sum(0);
+    vector<thread> threads;
+    for(size_t t = 0; t < 2 * TaskPool::max_external; ++t)
+    {
+        threads.emplace_back([&]() {
+            parallel_for(20, [&](size_t i) {
+                parallel_for(10, [&](size_t j) { sum += i * j; });
+            });
+        });
+    }
+    for(thread& t : threads)
+        t.join();
+    CHECK(sum == 2 * (long)TaskPool::max_external * 190 * 45);
+
+    // the first exception is re-thrown by `wait`, the other tasks still run
+    atomic<size_t> num_run(0);
+    TaskGroup g;
+    for(size_t i = 0; i < 8; ++i)
+    {
+        g.run([&, i]() {
+            ++num_run;
+            if(i % 2 == 0)
+                throw runtime_error("task failed");
+        });
+    }
+    CHECK_THROW(g.wait(), runtime_error);
+    CHECK(num_run == 8);
+    g.wait(); // the exception is only re-thrown once
+
+    // a thread waiting for tasks running in other threads sleeps
+    const clock_t cpu_start = clock();
+    {
+        TaskGroup sleeping;
+        for(size_t i = 0; i < 3; ++i)
+            sleeping.run([]() { this_thread::sleep_for(chrono::milliseconds(200)); });
+        sleeping.wait();
+    }
+    CHECK(double(clock() - cpu_start) / CLOCKS_PER_SEC < 0.1);
+
+    // with one thread, the waiting thread runs all the tasks
+    TaskPool::instance().resize(1);
+    sum = 0;
+    parallel_for(100, [&](size_t i) { sum += i; });
+    CHECK(sum == 4950);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+#include "Worker.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+using namespace std;
+using namespace Eigen;
+typedef chrono::steady_clock Clock;
+
+static double since(Clock::time_point t)
+{
+    return chrono::duration<double>(Clock::now() - t).count();
+}
+// replies x + y, and exits, hangs or replies garbage for the special values
+// of x
+static const char* script = R"(
+$| = 1;
+my $header = <STDIN>;
+while(my $line = <STDIN>)
+{
+    my ($x, $y) = split ' ', $line;
+    exit 1 if($x == 1);
+    sleep 30 if($x == 2);
+    if($x == 3) { print "nan?\n"; next; }
+    print $x + $y, " ", $x * $y, "\n";
+}
+)";
+int main()
+{
+    char dir[] = "/tmp/test_worker_XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    ofstream(string(dir) + "/worker.pl") << script;
+
+    Worker worker(dir, "worker.pl", {"x", "y"});
+    VectorXd x(2), y;
+    x << 4, 5;
+    CHECK(worker.eval(x, 2, 0, y) == ProcStatus::Success);
+    CHECK(y.size() == 2 and y(0) == 9 and y(1) == 20);
+
+    // the worker exits, a new one is started for the next evaluation
+    x << 1, 0;
+    CHECK(worker.eval(x, 2, 0, y) == ProcStatus::Failure);
+    x << 4, 6;
+    CHECK(worker.eval(x, 2, 0, y) == ProcStatus::Success);
+    CHECK(y(0) == 10);
+
+    // an invalid reply
+    x << 3, 0;
+    CHECK(worker.eval(x, 2, 0, y) == ProcStatus::Failure);
+    x << 0.5, 0.25;
+    CHECK(worker.eval(x, 2, 0, y) == ProcStatus::Success);
+    CHECK(y(0) == 0.75 and y(1) == 0.125);
+
+    // a hanging worker is killed on timeout
+    Clock::time_point t1 = Clock::now();
+    x << 2, 0;
+    CHECK(worker.eval(x, 2, 0.3, y) == ProcStatus::Timeout);
+    CHECK(since(t1) < 5);
+
+    // cancelled by the flag of the calling thread
+    atomic<bool> cancel(false);
+    thread canceller([&]() {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        cancel = true;
+    });
+    t1 = Clock::now();
+    {
+        EvalCancelScope scope(&cancel);
+        CHECK(worker.eval(x, 2, 0, y) == ProcStatus::Cancelled);
+    }
+    CHECK(since(t1) < 5);
+    canceller.join();
+
+    x << 1.5, 2;
+    CHECK(worker.eval(x, 2, 0, y) == ProcStatus::Success);
+    CHECK(y(0) == 3.5 and y(1) == 3);
+
+    remove((string(dir) + "/worker.pl").c_str());
+    remove((string(dir) + "/output_info.log").c_str());
+    rmdir(dir);
+    return EXIT_SUCCESS;
+}